@@ -0,0 +1,266 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "ecs/ecsmanager.hpp"
+#include "ecs/system.hpp"
+#include "ecs/component.hpp"
+
+/**
+ * Microbenchmark of ecs hot paths.
+ * Usage: LifeEcsBench [--min N] [--max N] [--out file.json]
+ * Sizes go from min to max multiplying by 10.
+ * Result is written as json with ns and allocations per operation.
+ * Operation is one entity for create, component and iterate benchmarks
+ * and one query for get_entities benchmarks.
+ */
+
+namespace
+{
+    std::atomic<size_t> allocs_count{0};
+}
+
+// Replacements aren't inlined, otherwise compiler sees pointer
+// from malloc() given to delete
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    allocs_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    ::operator delete(ptr);
+}
+
+struct BenchPosComponent : ecs::Component
+{
+    float x = 0.f, y = 0.f, z = 0.f;
+};
+
+struct BenchVelComponent : ecs::Component
+{
+    float x = 1.f, y = 1.f, z = 1.f;
+};
+
+struct BenchTagComponent : ecs::Component
+{
+};
+
+class BenchSystem : public ecs::System<BenchPosComponent, BenchVelComponent>
+{
+public:
+    size_t queryAll() const
+    {
+        return getEntities().size();
+    }
+
+    size_t queryTags() const
+    {
+        return getEntitiesByTags<BenchPosComponent, BenchVelComponent>().size();
+    }
+
+protected:
+    void update_state(size_t) override
+    {
+    }
+};
+
+class BenchWorld : public ecs::EcsManager
+{
+public:
+    BenchWorld() : ecs::EcsManager(1)
+    {};
+
+    void init() override
+    {
+        m_system = &createSystem<BenchSystem>();
+    }
+
+    void update(size_t) override
+    {
+    }
+
+    BenchSystem& getSystem()
+    {
+        return *m_system;
+    }
+
+private:
+    BenchSystem* m_system = nullptr;
+};
+
+struct BenchResult
+{
+    std::string name;
+    size_t entities;
+    size_t ops;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+/**
+ * Run func once and measure time and allocations of it
+ * @tparam Func
+ * @param name
+ * @param entities
+ * @param ops number of operations done by func
+ * @param func
+ * @return
+ */
+template<class Func>
+BenchResult measure(const std::string& name, size_t entities, size_t ops, Func&& func)
+{
+    size_t allocs = allocs_count.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    allocs = allocs_count.load(std::memory_order_relaxed) - allocs;
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return {name, entities, ops, ns / ops, static_cast<double>(allocs) / ops};
+}
+
+/**
+ * Benchmark all operations on world with count entities
+ * @param count
+ * @param results
+ */
+void bench_size(size_t count, std::vector<BenchResult>& results)
+{
+    BenchWorld world;
+    world.init();
+    auto& entities = world.getEntities();
+    entities.reserve(count);
+
+    // Repeat fast operations on small worlds to get stable numbers
+    size_t reps = std::max<size_t>(1, 1000000 / count);
+    volatile size_t sink = 0;
+
+    results.emplace_back(measure("create", count, count, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            world.createEntity(i)->addComponents<BenchPosComponent, BenchVelComponent>();
+    }));
+
+    results.emplace_back(measure("add_component", count, count, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            entities[i]->addComponent<BenchTagComponent>();
+    }));
+
+    results.emplace_back(measure("remove_component", count, count, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            entities[i]->removeComponent<BenchTagComponent>();
+    }));
+
+    results.emplace_back(measure("get_entities", count, reps, [&]() {
+        for (size_t r = 0; r < reps; ++r)
+            sink = sink + world.getSystem().queryAll();
+    }));
+
+    results.emplace_back(measure("get_entities_by_tags", count, reps, [&]() {
+        for (size_t r = 0; r < reps; ++r)
+            sink = sink + world.getSystem().queryTags();
+    }));
+
+    results.emplace_back(measure("iterate", count, count * reps, [&]() {
+        for (size_t r = 0; r < reps; ++r)
+            for (const auto& [name, en]: entities) {
+                auto [pos, vel] =
+                        en->getComponentsPtr<BenchPosComponent, BenchVelComponent>();
+                pos->x += vel->x;
+                pos->y += vel->y;
+                pos->z += vel->z;
+            }
+    }));
+
+    results.emplace_back(measure("iterate_shared", count, count * reps, [&]() {
+        for (size_t r = 0; r < reps; ++r)
+            for (const auto& [name, en]: entities) {
+                auto pos = en->getComponent<BenchPosComponent>();
+                auto vel = en->getComponent<BenchVelComponent>();
+                pos->x += vel->x;
+                pos->y += vel->y;
+                pos->z += vel->z;
+            }
+    }));
+
+    results.emplace_back(measure("destroy", count, count, [&]() {
+        for (size_t i = 0; i < count; ++i)
+            entities.erase(i);
+    }));
+}
+
+void write_json(std::ostream& out, const std::vector<BenchResult>& results)
+{
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& res = results[i];
+        out << "    {\"name\": \"" << res.name << "\", "
+            << "\"entities\": " << res.entities << ", "
+            << "\"ops\": " << res.ops << ", "
+            << "\"ns_per_op\": " << res.nsPerOp << ", "
+            << "\"allocs_per_op\": " << res.allocsPerOp << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    size_t minSize = 1000;
+    size_t maxSize = 10000000;
+    std::string outFile;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+
+        if (arg == "--min")
+            minSize = std::stoull(argv[++i]);
+        else if (arg == "--max")
+            maxSize = std::stoull(argv[++i]);
+        else if (arg == "--out")
+            outFile = argv[++i];
+        else {
+            std::cerr << "Unknown argument " << arg << "\n"
+                      << "Usage: LifeEcsBench [--min N] [--max N] [--out file.json]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (size_t size = std::max<size_t>(1, minSize); size <= maxSize; size *= 10) {
+        std::cerr << "Benchmarking " << size << " entities\n";
+        bench_size(size, results);
+    }
+
+    if (outFile.empty()) {
+        write_json(std::cout, results);
+    } else {
+        std::ofstream out(outFile);
+        if (!out) {
+            std::cerr << "Can't open " << outFile << "\n";
+            return EXIT_FAILURE;
+        }
+        write_json(out, results);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+#ifndef FIELDCOMPONENT_HPP
+#define FIELDCOMPONENT_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "ecs/component.hpp"
+
+/**
+ * Pack color to RGBA8
+ * @param color
+ * @return
+ */
+inline uint32_t pack_color(const glm::vec4& color)
+{
+    auto channel = [](GLfloat val) {
+        return static_cast<uint32_t>(std::clamp(val, 0.f, 1.f) * 255.f + 0.5f);
+    };
+
+    return channel(color.x) | channel(color.y) << 8
+           | channel(color.z) << 16 | channel(color.w) << 24;
+}
+
+/**
+ * Unpack color from RGBA8
+ * @param color
+ * @return
+ */
+inline glm::vec4 unpack_color(uint32_t color)
+{
+    return glm::vec4((color & 0xFF) / 255.f, (color >> 8 & 0xFF) / 255.f,
+                     (color >> 16 & 0xFF) / 255.f, (color >> 24 & 0xFF) / 255.f);
+}
+
+/**
+ * Dense voxel field.
+ * Cells are stored contiguously, index of cell is
+ * (x * sizeY + y) * sizeZ + z. Position of cell is computed from its
+ * indices. Field is split to cubic chunks of chunk_size cells,
+ * each chunk remembers version of the field when it was changed last time.
+ */
+struct FieldComponent : ecs::Component
+{
+    static constexpr size_t chunk_size = 16;
+
+    /**
+     * Part of field. Cells from begin (inclusive) to end (exclusive).
+     */
+    struct Chunk
+    {
+        size_t index;
+        size_t beginX, beginY, beginZ;
+        size_t endX, endY, endZ;
+    };
+
+    /**
+     * Resize field and kill all cells
+     * @param x
+     * @param y
+     * @param z
+     */
+    void resize(size_t x, size_t y, size_t z)
+    {
+        sizeX = x;
+        sizeY = y;
+        sizeZ = z;
+        chunksX = (x + chunk_size - 1) / chunk_size;
+        chunksY = (y + chunk_size - 1) / chunk_size;
+        chunksZ = (z + chunk_size - 1) / chunk_size;
+
+        alive.assign(x * y * z, 0);
+        colors.assign(x * y * z, 0);
+        generation = 0;
+        chunkVersions.assign(chunksX * chunksY * chunksZ, ++version);
+    }
+
+    size_t index(size_t x, size_t y, size_t z) const
+    {
+        return (x * sizeY + y) * sizeZ + z;
+    }
+
+    size_t size() const
+    {
+        return alive.size();
+    }
+
+    glm::vec3 position(size_t x, size_t y, size_t z) const
+    {
+        return {cellSize * x, cellSize * y, cellSize * z};
+    }
+
+    bool isAlive(size_t x, size_t y, size_t z) const
+    {
+        return alive[index(x, y, z)] != 0;
+    }
+
+    size_t chunkIndex(size_t x, size_t y, size_t z) const
+    {
+        return ((x / chunk_size) * chunksY + y / chunk_size) * chunksZ
+               + z / chunk_size;
+    }
+
+    size_t chunksCount() const
+    {
+        return chunkVersions.size();
+    }
+
+    Chunk getChunk(size_t idx) const
+    {
+        size_t cz = idx % chunksZ;
+        size_t cy = idx / chunksZ % chunksY;
+        size_t cx = idx / chunksZ / chunksY;
+
+        return {idx,
+                cx * chunk_size, cy * chunk_size, cz * chunk_size,
+                std::min(sizeX, (cx + 1) * chunk_size),
+                std::min(sizeY, (cy + 1) * chunk_size),
+                std::min(sizeZ, (cz + 1) * chunk_size)};
+    }
+
+    /**
+     * Call func(x, y, z, idx) for each cell of chunk
+     * @tparam Func
+     * @param chunk
+     * @param func
+     */
+    template<class Func>
+    void forEachCell(const Chunk& chunk, Func&& func) const
+    {
+        for (size_t x = chunk.beginX; x < chunk.endX; ++x)
+            for (size_t y = chunk.beginY; y < chunk.endY; ++y)
+                for (size_t z = chunk.beginZ; z < chunk.endZ; ++z)
+                    func(x, y, z, index(x, y, z));
+    }
+
+    /**
+     * Mark chunk which contains cell as changed in current version
+     * @param x
+     * @param y
+     * @param z
+     */
+    void markCellChanged(size_t x, size_t y, size_t z)
+    {
+        chunkVersions[chunkIndex(x, y, z)] = version;
+    }
+
+    size_t sizeX = 0;
+    size_t sizeY = 0;
+    size_t sizeZ = 0;
+    size_t chunksX = 0;
+    size_t chunksY = 0;
+    size_t chunksZ = 0;
+    GLfloat cellSize = 1.f;
+
+    uint64_t generation = 0;
+    // Increased on each field modification, never reset
+    uint64_t version = 0;
+
+    std::vector<uint8_t> alive;
+    // Packed RGBA8 colors
+    std::vector<uint32_t> colors;
+    std::vector<uint64_t> chunkVersions;
+};
+
+#endif //FIELDCOMPONENT_HPP
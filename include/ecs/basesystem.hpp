@@ -1,6 +1,11 @@
 #ifndef BASESYSTEM_HPP
 #define BASESYSTEM_HPP
 
+#include <set>
+#include <algorithm>
+
+#include "typelist.hpp"
+
 namespace ecs
 {
     class EcsManager;
@@ -11,7 +16,8 @@ namespace ecs
     class BaseSystem
     {
     public:
-        BaseSystem() : m_stopped(false), m_ecsManager(nullptr)
+        BaseSystem() : m_stopped(false), m_ecsManager(nullptr),
+                       m_mainThread(false)
         {};
 
         virtual ~BaseSystem() = default;
@@ -43,11 +49,95 @@ namespace ecs
             m_stopped = false;
         }
 
+        /**
+         * Id's of component types which system reads
+         * @return
+         */
+        const std::set<size_t>& getReads() const
+        {
+            return m_reads;
+        }
+
+        /**
+         * Id's of component types which system writes
+         * @return
+         */
+        const std::set<size_t>& getWrites() const
+        {
+            return m_writes;
+        }
+
+        /**
+         * Whether system must be updated from the thread which
+         * owns gl context and SDL event queue
+         * @return
+         */
+        bool isMainThread() const
+        {
+            return m_mainThread;
+        }
+
+        /**
+         * Two systems conflict if one of them writes component
+         * which other reads or writes. Conflicting systems can't
+         * be updated at the same time.
+         * @param other
+         * @return
+         */
+        bool conflictsWith(const BaseSystem& other) const
+        {
+            auto intersects = [](const std::set<size_t>& left,
+                                 const std::set<size_t>& right) {
+                return std::any_of(left.begin(), left.end(),
+                                   [&right](size_t t) {
+                                       return right.contains(t);
+                                   });
+            };
+
+            return intersects(m_writes, other.m_writes)
+                   || intersects(m_writes, other.m_reads)
+                   || intersects(m_reads, other.m_writes);
+        }
+
     protected:
         virtual void update_state(size_t delta) = 0;
 
+        /**
+         * Declare component types which system reads
+         * @tparam ComponentTypes
+         */
+        template<class ...ComponentTypes>
+        void reads()
+        {
+            (m_reads.insert(types::type_id<ComponentTypes>), ...);
+        }
+
+        /**
+         * Declare component types which system writes
+         * @tparam ComponentTypes
+         */
+        template<class ...ComponentTypes>
+        void writes()
+        {
+            (m_writes.insert(types::type_id<ComponentTypes>), ...);
+        }
+
+        /**
+         * Pin system to main thread. Use it for systems which
+         * touch gl, SDL or other global state.
+         */
+        void runOnMainThread()
+        {
+            m_mainThread = true;
+        }
+
         EcsManager *m_ecsManager;
         bool m_stopped;
+
+    private:
+        std::set<size_t> m_reads;
+        std::set<size_t> m_writes;
+        bool m_mainThread;
     };
 };
 
@@ -1,6 +1,8 @@
 #ifndef COMPONENT_HPP
 #define COMPONENT_HPP
 
+#include <cstdint>
+
 namespace ecs
 {
     /**
@@ -9,9 +11,27 @@ namespace ecs
     class Component
     {
     public:
-        Component(){};
+        Component() : m_changeTick(0)
+        {};
 
         virtual ~Component() = default;
+
+        /**
+         * Tick of the last change. 0 if component never changed.
+         * @return
+         */
+        uint64_t getChangeTick() const
+        {
+            return m_changeTick;
+        }
+
+        void setChangeTick(uint64_t tick)
+        {
+            m_changeTick = tick;
+        }
+
+    private:
+        uint64_t m_changeTick;
     };
 };
 
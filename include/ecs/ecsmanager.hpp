@@ -2,9 +2,16 @@
 #define ECSMANAGER_HPP
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
 
 #include "entity.hpp"
 #include "basesystem.hpp"
+#include "scheduler.hpp"
+#include "utils/threadpool.hpp"
 
 namespace ecs
 {
@@ -16,6 +23,12 @@ namespace ecs
     class EcsManager
     {
     public:
+        explicit EcsManager(size_t threadsCount) : m_pool(threadsCount),
+                                                   m_tick(0), m_horizon(0)
+        {};
+
+        virtual ~EcsManager() = default;
+
         /**
          * Create systems, etc...
          */
@@ -42,19 +55,164 @@ namespace ecs
 
             std::shared_ptr<SystemType> system(new SystemType());
             system->setEcsManager(this);
-            m_systems.insert({types::type_id<SystemType>,
-                              std::static_pointer_cast<BaseSystem>(system)});
+            auto res = m_systems.insert({types::type_id<SystemType>,
+                                         std::static_pointer_cast<BaseSystem>(system)});
+            if (!res.second)
+                return *std::static_pointer_cast<SystemType>(res.first->second);
+
+            m_scheduler.addSystem(res.first->second);
             return *system;
         }
 
+        /**
+         * Remove all systems
+         */
+        virtual void clearSystems()
+        {
+            m_systems.clear();
+            m_scheduler.clear();
+        }
+
+        /**
+         * Update systems. Non conflicting systems are updated
+         * in parallel on thread pool.
+         * @param delta
+         */
+        virtual void updateSystems(size_t delta)
+        {
+            m_scheduler.run(delta, m_pool);
+        }
+
+        ThreadPool& getThreadPool()
+        {
+            return m_pool;
+        }
+
         virtual std::unordered_map<size_t, std::shared_ptr<Entity>> &getEntities()
         {
             return m_entities;
         }
 
+        /**
+         * Current change tick. Each change gets its own tick, so
+         * everything changed after this call has greater tick.
+         * @return
+         */
+        uint64_t getTick() const
+        {
+            return m_tick.load();
+        }
+
+        /**
+         * Mark ComponentType of entities with names as changed.
+         * Names of removed entities also may be passed.
+         * @tparam ComponentType
+         * @param names
+         */
+        template<class ComponentType>
+        void markChanged(const std::vector<size_t>& names)
+        {
+            static_assert(std::is_base_of_v<Component, ComponentType>,
+                          "Template parameter class must be child of Component");
+            if (names.empty())
+                return;
+
+            std::lock_guard<std::mutex> lock(m_changesMut);
+            auto& log = m_changes[types::type_id<ComponentType>];
+            for (size_t name: names) {
+                uint64_t tick = ++m_tick;
+                if (auto it = m_entities.find(name); it != m_entities.end())
+                    if (auto comp = it->second->template getComponentPtr<ComponentType>())
+                        comp->setChangeTick(tick);
+
+                log.emplace_back(tick, name);
+            }
+        }
+
+        template<class ComponentType>
+        void markChanged(size_t name)
+        {
+            markChanged<ComponentType>(std::vector<size_t>{name});
+        }
+
+        /**
+         * Return names of entities which ComponentType changed
+         * after tick since. Names are unique and sorted.
+         * @tparam ComponentType
+         * @param since
+         * @return
+         */
+        template<class ComponentType>
+        std::vector<size_t> getChangedEntities(uint64_t since)
+        {
+            static_assert(std::is_base_of_v<Component, ComponentType>,
+                          "Template parameter class must be child of Component");
+            std::vector<size_t> res;
+
+            std::lock_guard<std::mutex> lock(m_changesMut);
+            if (since < m_horizon) {
+                // Log was already trimmed, look at entities directly
+                for (const auto& [name, en]: m_entities) {
+                    auto comp = en->template getComponentPtr<ComponentType>();
+                    if (comp && comp->getChangeTick() > since)
+                        res.emplace_back(name);
+                }
+            } else if (auto it = m_changes.find(types::type_id<ComponentType>);
+                       it != m_changes.end()) {
+                const auto& log = it->second;
+                auto first = std::upper_bound(
+                        log.begin(), log.end(), since,
+                        [](uint64_t tick, const auto& change) {
+                            return tick < change.first;
+                        });
+                for (; first != log.end(); ++first)
+                    res.emplace_back(first->second);
+            }
+
+            std::sort(res.begin(), res.end());
+            res.erase(std::unique(res.begin(), res.end()), res.end());
+            return res;
+        }
+
+        /**
+         * Must be called once per frame. Drops changes which are
+         * older than change_log_frames frames.
+         */
+        void nextFrame()
+        {
+            std::lock_guard<std::mutex> lock(m_changesMut);
+            m_frames.push_back(m_tick.load());
+            if (m_frames.size() <= change_log_frames)
+                return;
+
+            m_horizon = m_frames.front();
+            m_frames.pop_front();
+            for (auto& [type, log]: m_changes) {
+                auto last = std::upper_bound(
+                        log.begin(), log.end(), m_horizon,
+                        [](uint64_t tick, const auto& change) {
+                            return tick < change.first;
+                        });
+                log.erase(log.begin(), last);
+            }
+        }
+
     protected:
+        ThreadPool m_pool;
         std::unordered_map<size_t, std::shared_ptr<Entity>> m_entities;
         std::unordered_map<size_t, std::shared_ptr<BaseSystem>> m_systems;
+        Scheduler m_scheduler;
+
+    private:
+        static constexpr size_t change_log_frames = 16;
+
+        std::atomic<uint64_t> m_tick;
+        // Ticks at frames start
+        std::deque<uint64_t> m_frames;
+        // Changes with tick <= m_horizon were dropped from log
+        uint64_t m_horizon;
+        std::unordered_map<size_t, std::vector<std::pair<uint64_t, size_t>>> m_changes;
+        std::mutex m_changesMut;
     };
 };
 
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <unordered_map>
+#include <tuple>
 
 #include "typelist.hpp"
 #include "component.hpp"
@@ -100,6 +101,8 @@ namespace ecs
 
         /**
          * Get component by type
+         * Components are stored by id of their type,
+         * so static cast is always correct here.
          * @tparam ComponentType
          * @return
          */
@@ -113,7 +116,54 @@ namespace ecs
             if (it == m_components.end())
                 return std::shared_ptr<ComponentType>(nullptr);
 
-            return std::dynamic_pointer_cast<ComponentType>(it->second);
+            return std::static_pointer_cast<ComponentType>(it->second);
+        }
+
+        /**
+         * Get non owning pointer to component by type.
+         * Doesn't touch reference counter, use it in hot loops.
+         * Return nullptr if entity hasn't such component.
+         * @tparam ComponentType
+         * @return
+         */
+        template<class ComponentType>
+        ComponentType* getComponentPtr() const
+        {
+            static_assert(std::is_base_of_v<Component, ComponentType>,
+                          "Template parameter class must be child of Component");
+
+            const auto& it = m_components.find(types::type_id<ComponentType>);
+            if (it == m_components.end())
+                return nullptr;
+
+            return static_cast<ComponentType*>(it->second.get());
+        }
+
+        /**
+         * Get non owning pointers to several components.
+         * Convenience wrapper: it does one getComponentPtr lookup per type,
+         * components are kept in map by type, so they can't be fetched
+         * by single lookup.
+         * auto [pos, sprite] = en->getComponentsPtr<PosComponent, SpriteComponent>();
+         * @tparam ComponentTypes
+         * @return
+         */
+        template<class ...ComponentTypes>
+        std::tuple<ComponentTypes*...> getComponentsPtr() const
+        {
+            static_assert(types::IsBaseOfRec<Component, types::TypeList<ComponentTypes...>>::value,
+                          "Template parameter class must be child of Component");
+
+            return {getComponentPtr<ComponentTypes>()...};
+        }
+
+        template<class ComponentType>
+        bool hasComponent() const
+        {
+            static_assert(std::is_base_of_v<Component, ComponentType>,
+                          "Template parameter class must be child of Component");
+
+            return m_components.find(types::type_id<ComponentType>) != m_components.end();
         }
 
         /**
@@ -127,7 +177,7 @@ namespace ecs
             static_assert(std::is_base_of_v<Component, ComponentType>,
                           "Template parameter class must be child of Component");
 
-            return std::dynamic_pointer_cast<ComponentType>(m_components[types::type_id<ComponentType>]);
+            return std::static_pointer_cast<ComponentType>(m_components[types::type_id<ComponentType>]);
         }
 
         template<class ComponentType>
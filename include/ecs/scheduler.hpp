@@ -0,0 +1,116 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <vector>
+#include <memory>
+
+#include "basesystem.hpp"
+#include "utils/threadpool.hpp"
+
+namespace ecs
+{
+    /**
+     * Systems scheduler.
+     * Builds dependency graph of systems from their declared
+     * reads and writes. Edge goes from earlier registered system
+     * to later one if they conflict. Graph is split to levels
+     * and systems from the same level are updated at the same time.
+     * Main thread systems are always updated in registration order.
+     * Systems which run on the pool must not wait for the pool.
+     */
+    class Scheduler
+    {
+    public:
+        Scheduler() : m_dirty(false)
+        {};
+
+        void addSystem(std::shared_ptr<BaseSystem> system)
+        {
+            m_systems.emplace_back(std::move(system));
+            m_dirty = true;
+        }
+
+        void clear()
+        {
+            m_systems.clear();
+            m_levels.clear();
+            m_dirty = false;
+        }
+
+        /**
+         * Update all systems level by level
+         * @param delta
+         * @param pool
+         */
+        void run(size_t delta, ThreadPool& pool)
+        {
+            if (m_dirty)
+                build();
+
+            for (const auto& level: m_levels) {
+                // Nothing to overlap with
+                if (level.size() == 1) {
+                    m_systems[level.front()]->update(delta);
+                    continue;
+                }
+
+                for (size_t idx: level)
+                    if (!m_systems[idx]->isMainThread())
+                        pool.addJob([system = m_systems[idx].get(), delta]() {
+                            system->update(delta);
+                        });
+
+                for (size_t idx: level)
+                    if (m_systems[idx]->isMainThread())
+                        m_systems[idx]->update(delta);
+
+                pool.waitForFinish();
+            }
+        }
+
+        /**
+         * Return levels of dependency graph.
+         * Each level contains indices of systems in registration order.
+         * @return
+         */
+        const std::vector<std::vector<size_t>>& getLevels()
+        {
+            if (m_dirty)
+                build();
+
+            return m_levels;
+        }
+
+    private:
+        /**
+         * Build dependency graph and split it by levels.
+         * Level of system is the length of the longest path to it.
+         */
+        void build()
+        {
+            std::vector<size_t> depth(m_systems.size(), 0);
+            size_t maxDepth = 0;
+            for (size_t i = 0; i < m_systems.size(); ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    bool mainThread = m_systems[i]->isMainThread()
+                                      && m_systems[j]->isMainThread();
+                    if (mainThread || m_systems[i]->conflictsWith(*m_systems[j]))
+                        depth[i] = std::max(depth[i], depth[j] + 1);
+                }
+                maxDepth = std::max(maxDepth, depth[i]);
+            }
+
+            m_levels.assign(m_systems.empty() ? 0 : maxDepth + 1, {});
+            for (size_t i = 0; i < m_systems.size(); ++i)
+                m_levels[depth[i]].emplace_back(i);
+
+            m_dirty = false;
+        }
+
+        std::vector<std::shared_ptr<BaseSystem>> m_systems;
+        std::vector<std::vector<size_t>> m_levels;
+        bool m_dirty;
+    };
+};
+
+#endif //SCHEDULER_HPP
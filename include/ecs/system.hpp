@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <set>
+#include <unordered_map>
 #include <memory>
 
 #include "typelist.hpp"
@@ -22,6 +23,8 @@ namespace ecs
         explicit System()
         {
             m_componentTypes.insert({types::type_id<Args>...});
+            // System reads at least components it handles
+            reads<Args...>();
         }
 
         virtual ~System() = default;
@@ -32,16 +35,14 @@ namespace ecs
          */
         auto getEntities() const
         {
-            auto filtered = m_ecsManager->getEntities();
-            for (auto it = filtered.begin(); it != filtered.end();) {
-                auto components = it->second->getComponents();
-                if (std::any_of(m_componentTypes.begin(), m_componentTypes.end(),
+            std::unordered_map<size_t, std::shared_ptr<Entity>> filtered;
+            for (const auto& [name, en]: m_ecsManager->getEntities()) {
+                const auto& components = en->getComponents();
+                if (std::all_of(m_componentTypes.begin(), m_componentTypes.end(),
                                 [&components](size_t t) {
-                                    return components.find(t) == components.end();
+                                    return components.find(t) != components.end();
                                 }))
-                    it = filtered.erase(it);
-                else
-                    ++it;
+                    filtered.emplace(name, en);
             }
 
             return filtered;
@@ -63,17 +64,15 @@ namespace ecs
 
             auto bin = [](bool x, bool y) { return x && y; };
 
-            auto filtered = m_ecsManager->getEntities();
-            for (auto it = filtered.begin(); it != filtered.end();) {
-                // Lambda to check that current entity (it) has
+            std::unordered_map<size_t, std::shared_ptr<Entity>> filtered;
+            for (const auto& [name, en]: m_ecsManager->getEntities()) {
+                // Lambda to check that current entity has
                 // each of ComponentTypes
-                auto un = [it](auto x) {
-                    return it->second->getComponent<decltype(x)>() != nullptr;
+                auto un = [&en](auto x) {
+                    return en->template hasComponent<decltype(x)>();
                 };
-                if (!typeListReduce<ComponentList>(un, bin))
-                    it = filtered.erase(it);
-                else
-                    ++it;
+                if (types::typeListReduce<ComponentList>(un, bin))
+                    filtered.emplace(name, en);
             }
 
             return filtered;
@@ -89,20 +88,40 @@ namespace ecs
         {
             static_assert(std::is_base_of_v<Component, ComponentType>,
                           "ComponentType class must be child of Component");
-            auto &filtered = m_ecsManager->getEntities();
-            for (auto it = filtered.begin(); it != filtered.end();) {
-                if (!it->second->getComponent<ComponentType>())
-                    it = filtered.erase(it);
-                else
-                    ++it;
-            }
+            std::unordered_map<size_t, std::shared_ptr<Entity>> filtered;
+            for (const auto& [name, en]: m_ecsManager->getEntities())
+                if (en->template hasComponent<ComponentType>())
+                    filtered.emplace(name, en);
 
             return filtered;
         }
 
+        /**
+         * Return names of entities which ComponentType changed since
+         * previous call of this function with the same ComponentType.
+         * First call returns all changes which are still in log.
+         * @tparam ComponentType
+         * @return
+         */
+        template<class ComponentType>
+        std::vector<size_t> getChangedEntities()
+        {
+            static_assert(std::is_base_of_v<Component, ComponentType>,
+                          "ComponentType class must be child of Component");
+            uint64_t& seen = m_seenTicks[types::type_id<ComponentType>];
+            uint64_t tick = m_ecsManager->getTick();
+            auto changed =
+                    m_ecsManager->getChangedEntities<ComponentType>(seen);
+            seen = tick;
+
+            return changed;
+        }
+
     private:
         // Contains id's of each component type system can handle
         std::set<size_t> m_componentTypes;
+        // Last seen change tick for each component type
+        std::unordered_map<size_t, uint64_t> m_seenTicks;
     };
 };
 
@@ -2,9 +2,14 @@
 #define MOONLANDER_GAME_HPP
 
 #include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
 
 #include "world.hpp"
+#include "render/framerecorder.hpp"
 
 #define WINDOW_FLAGS (SDL_WINDOW_SHOWN | SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE)
 #define IMG_FLAGS IMG_INIT_PNG
@@ -23,6 +28,87 @@ void setGameState(GameStates state);
 GameStates getGameState();
 GameStates getPrevGameState();
 
+/**
+ * Scene must be rendered again. Call it after changes which
+ * are visible in the scene (camera, window size, etc).
+ */
+void markSceneDirty();
+bool isSceneDirty();
+void clearSceneDirty();
+
+enum class SimulationRequest
+{
+    NONE,
+    SAVE,
+    LOAD,
+    // Play journal from config instead of simulation
+    REPLAY
+};
+
+/**
+ * Ask world to save or load simulation snapshot on next update.
+ * Gui can't touch field itself, it is owned by world.
+ * @param request
+ */
+void requestSimulation(SimulationRequest request);
+/**
+ * Get pending request and reset it
+ * @return
+ */
+SimulationRequest takeSimulationRequest();
+
+/**
+ * Generations which can be shown again from history
+ */
+struct HistoryRange
+{
+    uint64_t first = 0;
+    uint64_t last = 0;
+    uint64_t current = 0;
+};
+
+void setHistoryRange(const HistoryRange& range);
+const HistoryRange& getHistoryRange();
+/**
+ * Ask world to show generation from history on next update
+ * @param generation
+ */
+void requestHistorySeek(uint64_t generation);
+/**
+ * Get pending seek and reset it
+ * @return
+ */
+std::optional<uint64_t> takeHistorySeek();
+
+/**
+ * Options of rendering without window. They come from command line
+ * and are never saved to config.
+ */
+struct HeadlessOptions
+{
+    bool enabled = false;
+    int width = 1280;
+    int height = 720;
+    // Frames to render, each frame is next generation. 0 is endless run
+    size_t frames = 100;
+    FrameFormat format = FrameFormat::PNG;
+    // Directory for png frames or y4m file
+    std::string output = "frames";
+    int fps = 30;
+    // Journal rendered instead of simulation, empty renders simulation
+    std::string replay;
+};
+
+void setHeadlessOptions(const HeadlessOptions& options);
+const HeadlessOptions& getHeadlessOptions();
+bool isHeadless();
+
+/**
+ * Size of rendered scene: display size or headless frame size
+ * @return
+ */
+glm::ivec2 getFrameSize();
+
 class Game
 {
 public:
@@ -30,6 +116,10 @@ public:
     ~Game();
 
     void initOnceSDL2();
+    /**
+     * Create window with gl context or surfaceless egl
+     * context in headless mode
+     */
     void initGL();
     void initGame();
 
@@ -50,6 +140,16 @@ public:
 public:
     bool vsync_supported;
 private:
+    /**
+     * Create window and its gl context
+     */
+    void create_window_context();
+    /**
+     * Create gl context without any surface, scene
+     * is rendered only to framebuffers
+     */
+    void create_headless_context();
+
     World m_world;
     static SDL_Window* m_window;
     static SDL_GLContext m_glcontext;
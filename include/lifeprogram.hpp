@@ -5,6 +5,7 @@
 #include <memory>
 
 #include "render/shaderprogram.hpp"
+#include "render/uniformring.hpp"
 
 class LifeProgram: public ShaderProgram
 {
@@ -41,6 +42,10 @@ public:
 
     void useScreenProgram();
     void useFramebufferProgram();
+    /**
+     * Program which draws field surface mesh to framebuffer
+     */
+    void useSurfaceProgram();
 
     /**
      * Init programs
@@ -52,15 +57,21 @@ private:
 
     GLuint m_frameBufProg;
     GLuint m_screenProg;
+    GLuint m_surfaceProg;
 
     GLint m_texLoc;
     GLint m_colorLoc;
 
-    GLuint m_matricesUBO;
+    std::unique_ptr<UniformRing> m_matricesRing;
     GLuint m_textureDataUBO;
 
     int m_isTextureRender;
 
+    /**
+     * Write all matrices to the next part of matrices ring
+     */
+    void upload_matrices();
+
     /**
      * Utility cleanup functions
      */
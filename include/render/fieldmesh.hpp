@@ -0,0 +1,103 @@
+#ifndef FIELDMESH_HPP
+#define FIELDMESH_HPP
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "components/fieldcomponent.hpp"
+#include "render/frustum.hpp"
+#include "utils/threadpool.hpp"
+
+/**
+ * Surface mesh of field.
+ * Only faces between live cell and dead or out of bounds
+ * neighbour are emitted. Coplanar faces of the same color are
+ * greedily merged to rectangles. Mesh is stored per field chunk, changed
+ * chunks are rebuilt in parallel and uploaded to their own buffers.
+ * Each chunk also has impostor, a box around its live cells, which
+ * is drawn instead of chunk far from camera.
+ */
+class FieldMesh
+{
+public:
+    /**
+     * Vertex of surface. Layout must match surface program.
+     */
+    struct Vertex
+    {
+        glm::vec3 pos;
+        // Position on the face in cells, fract of it gives outline
+        glm::vec2 cellCoords;
+        // Packed RGBA8 color
+        uint32_t color;
+    };
+
+    FieldMesh();
+    ~FieldMesh();
+
+    FieldMesh(const FieldMesh&) = delete;
+    FieldMesh& operator=(const FieldMesh&) = delete;
+
+    /**
+     * Drop all chunks, next update rebuilds everything
+     * @param chunksCount
+     */
+    void reset(size_t chunksCount);
+
+    /**
+     * Rebuild chunks changed since last update
+     * @param field
+     * @param pool
+     * @param colored if false colors of cells are ignored and faces
+     * of all colors are merged
+     */
+    void update(const FieldComponent& field, ThreadPool& pool, bool colored);
+
+    /**
+     * Draw chunks visible in frustum with currently used program.
+     * Chunks farther than lodDistance from eye are drawn as impostors.
+     * @param frustum
+     * @param eye
+     * @param lodDistance
+     */
+    void draw(const Frustum& frustum, const glm::vec3& eye,
+              GLfloat lodDistance) const;
+
+    /**
+     * Triangles count of whole mesh
+     * @return
+     */
+    size_t getTrianglesCount() const;
+
+private:
+    struct ChunkMesh
+    {
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        // Indices of surface, impostor indices go right after them
+        GLsizei indicesCount = 0;
+        GLsizei impostorCount = 0;
+
+        // Box around live cells of chunk
+        glm::vec3 boxMin{0.f};
+        glm::vec3 boxMax{0.f};
+    };
+
+    static void build_chunk(const FieldComponent& field, size_t idx,
+                            bool colored, ChunkMesh& mesh);
+    static void upload_chunk(ChunkMesh& mesh);
+    void free_chunks();
+
+    std::vector<ChunkMesh> m_chunks;
+    uint64_t m_version;
+    bool m_colored;
+};
+
+#endif //FIELDMESH_HPP
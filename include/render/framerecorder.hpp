@@ -0,0 +1,78 @@
+#ifndef FRAMERECORDER_HPP
+#define FRAMERECORDER_HPP
+
+#include <array>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+enum class FrameFormat
+{
+    // Sequence of frame_000000.png files in output directory
+    PNG,
+    // Raw YUV4MPEG2 stream in output file
+    Y4M
+};
+
+/**
+ * Write rendered frames to disk.
+ * Frame is copied from framebuffer to one of pixel pack buffers and
+ * is read from it a few frames later, so capture doesn't wait for gpu.
+ */
+class FrameRecorder
+{
+public:
+    FrameRecorder(GLsizei width, GLsizei height, FrameFormat frameFormat,
+                  std::string output, int fps);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /**
+     * Start reading color attachment 0 of framebuffer.
+     * Frames whose reading is finished are written.
+     * @param framebuffer
+     */
+    void capture(GLuint framebuffer);
+
+    /**
+     * Wait for all started frames and write them
+     */
+    void finish();
+
+    size_t getFramesCount() const;
+
+private:
+    static constexpr size_t buffers_count = 3;
+
+    /**
+     * Map oldest pending buffer and write its frame
+     * @param wait if false frame is written only if gpu finished it
+     * @return whether frame was written
+     */
+    bool write_oldest(bool wait);
+    void write_png(const uint8_t* pixels);
+    void write_y4m(const uint8_t* pixels);
+
+    GLsizei m_width;
+    GLsizei m_height;
+    FrameFormat m_format;
+    std::string m_output;
+    int m_fps;
+
+    std::array<GLuint, buffers_count> m_buffers;
+    std::array<GLsync, buffers_count> m_fences;
+    // Buffers with started reading, oldest first
+    std::deque<size_t> m_pending;
+    size_t m_next;
+    size_t m_framesCount;
+
+    // Frame flipped to top to bottom rows or converted to yuv planes
+    std::vector<uint8_t> m_frame;
+    std::ofstream m_stream;
+};
+
+#endif //FRAMERECORDER_HPP
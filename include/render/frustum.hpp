@@ -0,0 +1,34 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <array>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+/**
+ * View frustum as six planes.
+ * Planes are extracted from projection * view * model matrix, so
+ * tests are done in the space where model matrix is applied.
+ */
+class Frustum
+{
+public:
+    explicit Frustum(const glm::mat4& matrix);
+
+    /**
+     * Whether axis aligned box is at least partially inside frustum.
+     * Test is conservative, some boxes near the corners of
+     * frustum may pass it while being outside.
+     * @param min
+     * @param max
+     * @return
+     */
+    bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+
+private:
+    // Left, right, bottom, top, near, far. Normals look inside
+    std::array<glm::vec4, 6> m_planes;
+};
+
+#endif //FRUSTUM_HPP
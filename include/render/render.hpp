@@ -28,7 +28,27 @@ namespace render
     void
     drawTexture(ShaderProgram& program, const Texture &texture,
                 const glm::vec3& position);
+
+    /**
+     * Render count instances of sprite with one draw call.
+     * Each instance takes vec3 offset (added to model space position)
+     * and packed RGBA8 color from instanceVBO. Stride of
+     * instance is stride bytes, color goes right after offset.
+     * @param program
+     * @param sprite
+     * @param instanceVBO
+     * @param first index of first instance in instanceVBO
+     * @param count
+     * @param stride
+     */
+    void drawTextureInstanced(ShaderProgram& program, const Sprite& sprite,
+                              GLuint instanceVBO, GLsizei first, GLsizei count,
+                              GLsizei stride);
     
+    /**
+     * Draw 2d primitives. Points are written to shared stream buffer,
+     * so they may be freed right after call.
+     */
     void drawLinen(const std::vector<vec2>& points, bool adjacency = false);
 
     void drawDots(const std::vector<vec2>& dots);
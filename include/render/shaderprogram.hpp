@@ -3,6 +3,7 @@
 
 #include <GL/glew.h>
 #include <string>
+#include <unordered_map>
 #include <glm/mat4x4.hpp>
 
 class ShaderProgram
@@ -38,6 +39,23 @@ public:
     virtual void setVec3(const std::string &name, const glm::vec3& value);
     virtual void setVec4(const std::string &name, const glm::vec4& value);
 
+    /**
+     * Location of uniform in current program, -1 if there is no such one.
+     * Locations are cached per program, so driver is asked only once.
+     * @param name
+     * @return
+     */
+    GLint getUniformLocation(const std::string& name);
+
+    /**
+     * Set uniform by location from getUniformLocation.
+     * These don't check gl errors, check them once after draw.
+     */
+    void setFloat(GLint loc, GLfloat value);
+    void setInt(GLint loc, GLint value);
+    void setVec3(GLint loc, const glm::vec3& value);
+    void setVec4(GLint loc, const glm::vec4& value);
+
     void bind() const;
     void unbind();
     GLuint getProgramID();
@@ -48,6 +66,9 @@ protected:
     glm::mat4 m_projectionMatrix;
     glm::mat4 m_modelMatrix;
     glm::mat4 m_viewMatrix;
+
+    // Uniform locations by program id
+    std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> m_uniformLocations;
 };
 
 #endif //SHADERPROGRAM_HPP
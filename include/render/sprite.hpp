@@ -3,6 +3,7 @@
 
 #include "texture.hpp"
 #include "utils/utils.hpp"
+#include "utils/texture.hpp"
 
 /**
  * Sprite class.
@@ -29,6 +30,7 @@ public:
     GLuint getIdx() const noexcept;
     void setIdx(GLuint idx);
     GLuint getSpritesCount() const noexcept;
+    GLsizei getIndicesCount() const override;
     GLuint getTextureID() const override;
 
     void generateDataBuffer() override;
@@ -42,7 +44,7 @@ protected:
 //    GLuint m_texCount;
 //    GLuint m_curIdx = 0;
 
-    std::vector<std::vector<GLfloat>> m_vertices;
+    std::vector<utils::texture::Mesh> m_meshes;
     std::vector<GLuint> m_textureIds;
 };
 
@@ -0,0 +1,106 @@
+#ifndef STREAMBUFFER_HPP
+#define STREAMBUFFER_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+
+/**
+ * Ring buffer for data which is written by cpu every frame and read
+ * by gpu once: dynamic vertices, uniform blocks.
+ * Buffer is split to three sections, one is written by cpu while two
+ * others may be still read by gpu. Section is fenced when cpu leaves it
+ * and the fence is waited before cpu writes to it again.
+ * With ARB_buffer_storage buffer is mapped once, persistently and
+ * coherently, so writes go straight to it. Without it data is copied
+ * from client side copy with glBufferSubData and storage is orphaned
+ * when ring wraps around.
+ */
+class StreamBuffer
+{
+protected:
+    static std::shared_ptr<StreamBuffer> instance;
+public:
+    /**
+     * Part of buffer given to caller
+     */
+    struct Allocation
+    {
+        // Write data here
+        void* data;
+        // Offset of data in buffer
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    explicit StreamBuffer(GLsizeiptr sectionSize);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    /**
+     * Buffer shared by all dynamic geometry. Must be called with
+     * current gl context.
+     * @return
+     */
+    static std::shared_ptr<StreamBuffer> getInstance();
+
+    /**
+     * Take size bytes from current section.
+     * Data must be written before commit and must not be touched after.
+     * @param size must not be greater than section size
+     * @param alignment
+     * @return
+     */
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+    /**
+     * Make written data visible to gl commands issued after this call
+     * @param alloc
+     */
+    void commit(const Allocation& alloc);
+
+    /**
+     * Allocate, copy data and commit
+     * @param data
+     * @param size
+     * @param alignment
+     * @return
+     */
+    Allocation write(const void* data, GLsizeiptr size,
+                     GLsizeiptr alignment = 16);
+
+    /**
+     * Fence current section and go to next one.
+     * Call it once per frame after all draws.
+     */
+    void nextFrame();
+
+    GLuint getBuffer() const;
+
+    bool isPersistent() const;
+
+private:
+    static constexpr size_t sections_count = 3;
+
+    void next_section();
+    void wait_section(size_t section);
+
+    GLuint m_buffer;
+    GLsizeiptr m_sectionSize;
+    size_t m_section;
+    // Offset in current section
+    GLintptr m_offset;
+
+    bool m_persistent;
+    uint8_t* m_mapped;
+    // Client side copy of buffer if it can't be mapped persistently
+    std::vector<uint8_t> m_staging;
+
+    std::array<GLsync, sections_count> m_fences;
+};
+
+#endif //STREAMBUFFER_HPP
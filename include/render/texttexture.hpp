@@ -24,6 +24,7 @@ public:
     void freeFont() noexcept;
 
     GLuint getVAO() const override;
+    GLsizei getIndicesCount() const override;
 private:
     std::string m_text;
     TTF_Font* m_font;
@@ -20,6 +20,11 @@ public:
     virtual GLuint getDepth() const noexcept;
 
     virtual GLuint getVAO() const = 0;
+    /**
+     * Count of indices in element buffer of vao
+     * @return
+     */
+    virtual GLsizei getIndicesCount() const = 0;
     virtual void generateDataBuffer() = 0;
 
     virtual void freeTexture() final;
@@ -0,0 +1,38 @@
+#ifndef UNIFORMRING_HPP
+#define UNIFORMRING_HPP
+
+#include <memory>
+#include <GL/glew.h>
+
+#include "render/streambuffer.hpp"
+
+/**
+ * Ring of uniform blocks in stream buffer.
+ * Each write goes to the next free aligned part of stream buffer which
+ * is bound to the binding point with glBindBufferRange. Parts which
+ * may be still used by previous draws are never overwritten, stream
+ * buffer fences them.
+ */
+class UniformRing
+{
+public:
+    explicit UniformRing(std::shared_ptr<StreamBuffer> stream);
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    /**
+     * Copy data to free part of ring and bind this part
+     * to uniform binding point
+     * @param binding
+     * @param data
+     * @param size
+     */
+    void bind(GLuint binding, const void* data, GLsizeiptr size);
+
+private:
+    std::shared_ptr<StreamBuffer> m_stream;
+    GLint m_alignment;
+};
+
+#endif //UNIFORMRING_HPP
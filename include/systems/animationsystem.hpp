@@ -12,6 +12,10 @@
  */
 class AnimationSystem : public ecs::System<SpriteComponent, AnimationComponent>
 {
+public:
+    explicit AnimationSystem();
+
+private:
     void update_state(size_t delta) override;
 };
 
@@ -6,6 +6,8 @@
 class ParticleRenderSystem : public ecs::System<>
 {
 public:
+    explicit ParticleRenderSystem();
+
     void update_state(size_t delta) override;
 };
 
@@ -4,9 +4,13 @@
 #include <GL/glew.h>
 
 #include "render/camera.hpp"
+#include "render/sprite.hpp"
 #include "components/textcomponent.hpp"
 #include "ecs/system.hpp"
 #include "components/positioncomponent.hpp"
+#include "components/fieldcomponent.hpp"
+#include "render/fieldmesh.hpp"
+#include "render/framerecorder.hpp"
 
 /**
  * System that can handle level surface
@@ -19,9 +23,94 @@ public:
 
     void update_state(size_t delta) override;
 private:
+    /**
+     * Per instance data of live cell.
+     * Layout must match instance attributes of framebuffer program.
+     */
+    struct LiveCell
+    {
+        // Offset of cell in model space
+        glm::vec3 offset;
+        // Packed RGBA8 color
+        uint32_t color;
+    };
+
+    /**
+     * Box around live cells of chunk, far chunks are drawn as
+     * one instance of it instead of their cells
+     */
+    struct ChunkImpostor
+    {
+        glm::vec3 boxMin;
+        glm::vec3 boxMax;
+        // Instance at center of box with average color of cells
+        LiveCell instance;
+    };
+
+    /**
+     * Settings which affect rendered scene
+     */
+    struct SceneSettings
+    {
+        glm::vec4 backgroundColor;
+        glm::vec4 cellColor;
+        glm::vec4 borderColor;
+        bool coloredLife;
+        bool surfaceMesh;
+        GLfloat lodDistance;
+        int width;
+        int height;
+
+        bool operator==(const SceneSettings&) const = default;
+    };
+
+    /**
+     * Pick up new field if it was changed
+     */
+    void updateField();
+    /**
+     * Whether scene must be rendered again. Scene is rendered
+     * again if it was marked dirty, field or settings were changed.
+     * @return
+     */
+    bool needRedraw();
+    /**
+     * Rebuild live cells and impostors of changed chunks and upload
+     * them to instance buffer
+     */
+    void updateLiveCells();
     void drawSprites();
+    /**
+     * Draw each live cell of visible chunks as instance of cell sprite.
+     * Chunks farther than lodDistance from eye are drawn as impostors.
+     * @param frustum
+     * @param eye
+     * @param lodDistance
+     */
+    void drawCells(const Frustum& frustum, const glm::vec3& eye,
+                   GLfloat lodDistance);
     void drawToFramebuffer();
 
+    // Live cells of each field chunk
+    std::vector<std::vector<LiveCell>> m_chunkCells;
+    // Index of first instance of each chunk in instance buffer
+    std::vector<GLsizei> m_chunkFirst;
+    // Impostors go to instance buffer after cells in order of chunks
+    std::vector<ChunkImpostor> m_chunkImpostors;
+    std::shared_ptr<FieldComponent> m_field;
+    uint64_t m_fieldVersion;
+    // Field version and settings of the last rendered scene
+    uint64_t m_drawnVersion;
+    SceneSettings m_drawnSettings;
+    std::shared_ptr<Sprite> m_cellSprite;
+
+    GLuint m_instanceVBO;
+    GLsizei m_instancesCount;
+
+    FieldMesh m_fieldMesh;
+    // Writes frames in headless mode, gui isn't drawn then
+    std::unique_ptr<FrameRecorder> m_recorder;
+
     GLuint m_frameBufferMSAA;
     GLuint m_frameBuffer;
 
@@ -35,6 +124,7 @@ private:
 
     bool m_isMsaa;
 
+    void init_gui();
     void drawGui();
 };
 
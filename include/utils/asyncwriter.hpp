@@ -0,0 +1,129 @@
+#ifndef ASYNCWRITER_HPP
+#define ASYNCWRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+    /**
+     * Sequential file writer which doesn't wait for the disk.
+     * Data goes to a few aligned buffers, full buffer is submitted to
+     * io_uring and the next one is filled meanwhile. Without io_uring
+     * buffers are written by pwrite on the calling thread. Buffers of
+     * zeros aren't written, they are left as holes of sparse file.
+     * With direct I/O page cache is bypassed, file is padded to block
+     * size while writing and truncated to its size in finish().
+     * FSException is thrown on errors.
+     */
+    class AsyncFileWriter
+    {
+    public:
+        /**
+         * Create or truncate file
+         * @param file
+         * @param direct try O_DIRECT, buffered I/O is used where it fails
+         * @param bufferSize size of each buffer, multiple of 4096
+         * @param buffersCount buffers in flight
+         */
+        AsyncFileWriter(const std::string& file, bool direct,
+                        size_t bufferSize = 4 << 20, size_t buffersCount = 4);
+        /**
+         * Writes in flight are waited, nothing is flushed
+         */
+        ~AsyncFileWriter();
+
+        AsyncFileWriter(const AsyncFileWriter&) = delete;
+        AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+        /**
+         * Free space of current buffer, waits for buffer to be written
+         * if all of them are busy
+         * @return pointer and size, size is never zero
+         */
+        std::pair<uint8_t*, size_t> acquire();
+
+        /**
+         * Append bytes written to acquired space
+         * @param size
+         */
+        void commit(size_t size);
+
+        /**
+         * Copy bytes to buffers
+         * @param data
+         * @param size
+         */
+        void write(const void* data, size_t size);
+
+        /**
+         * Append zeros up to alignment
+         * @param alignment
+         */
+        void pad(size_t alignment);
+
+        /**
+         * Write the rest, wait for all writes, flush file data
+         * to disk and close file
+         */
+        void finish();
+
+        /**
+         * @return bytes appended so far
+         */
+        uint64_t size() const;
+
+        bool isAsync() const;
+        bool isDirect() const;
+
+    private:
+        struct Buffer
+        {
+            uint8_t* data;
+            size_t used;
+            // File offset of submitted write
+            uint64_t offset;
+            bool busy;
+        };
+
+        struct Ring;
+
+        void submit(Buffer& buffer);
+        /**
+         * Wait for one write in flight
+         */
+        void complete();
+        /**
+         * Write synchronously, short writes are continued
+         * @param data
+         * @param size
+         * @param offset
+         */
+        void write_at(const uint8_t* data, size_t size, uint64_t offset);
+        void close_file();
+
+        std::string m_file;
+        int m_fd;
+        bool m_direct;
+        size_t m_bufferSize;
+        std::vector<Buffer> m_buffers;
+        size_t m_current;
+        // File offset of current buffer
+        uint64_t m_offset;
+        std::unique_ptr<Ring> m_ring;
+        size_t m_inFlight;
+    };
+
+    /**
+     * Flush directory entries of file's directory, so creation or
+     * rename of file isn't lost on crash
+     * @param file
+     */
+    void sync_directory(const std::string& file);
+}
+
+#endif //ASYNCWRITER_HPP
@@ -0,0 +1,90 @@
+#ifndef CHECKPOINTER_HPP
+#define CHECKPOINTER_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "utils/snapshot.hpp"
+#include "components/fieldcomponent.hpp"
+
+namespace utils
+{
+    /**
+     * Periodic snapshots of simulation written on background thread.
+     * Field is copied to spare planes between generations, so simulation
+     * goes on while copy is written. Checkpoints are numbered files
+     * checkpoint_00000001.lifesnap in directory, only the newest
+     * ones are kept.
+     */
+    class Checkpointer
+    {
+    public:
+        /**
+         * @param dir directory of checkpoints, created if missing
+         * @param keep count of checkpoints kept on disk
+         * @param directIo write checkpoints bypassing page cache
+         */
+        Checkpointer(std::string dir, size_t keep, bool directIo = false);
+        ~Checkpointer();
+
+        Checkpointer(const Checkpointer&) = delete;
+        Checkpointer& operator=(const Checkpointer&) = delete;
+
+        /**
+         * Copy field and queue writing of copy.
+         * Checkpoint is skipped if previous one is still written.
+         * @param field
+         * @param info
+         * @return whether checkpoint was queued
+         */
+        bool checkpoint(const FieldComponent& field,
+                        const snapshot::SnapshotInfo& info);
+
+        /**
+         * Wait until queued checkpoint is written
+         */
+        void wait();
+
+        /**
+         * Load the newest checkpoint which is read without errors.
+         * Broken checkpoints are logged and skipped.
+         * @param dir
+         * @param field
+         * @param pool checksums are compared in parallel if it is given
+         * @return parameters of loaded simulation or nothing if
+         * there is no valid checkpoint
+         */
+        static std::optional<snapshot::SnapshotInfo>
+        restore(const std::string& dir, FieldComponent& field,
+                ThreadPool* pool = nullptr);
+
+    private:
+        void loop();
+        /**
+         * Write copy to next numbered file and remove old checkpoints
+         */
+        void write_copy();
+
+        std::string m_dir;
+        size_t m_keep;
+        bool m_directIo;
+        // Number of the next checkpoint file
+        size_t m_next;
+
+        // Copy of field owned by writer thread while m_busy is set
+        FieldComponent m_copy;
+        snapshot::SnapshotInfo m_info;
+        bool m_busy;
+        bool m_terminate;
+
+        std::mutex m_mutex;
+        std::condition_variable m_hasJob;
+        std::condition_variable m_finished;
+        std::thread m_thread;
+    };
+}
+
+#endif //CHECKPOINTER_HPP
@@ -0,0 +1,45 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "utils/threadpool.hpp"
+
+/**
+ * Integrity checks of simulation files.
+ * CRC32C (Castagnoli) is computed by SSE4.2 instruction where CPU has it,
+ * three streams at once, otherwise by tables 8 bytes per step.
+ */
+namespace utils::checksum
+{
+    /**
+     * CRC32C of bytes, long data is continued by passing previous result
+     * @param data
+     * @param size
+     * @param crc result for preceding bytes, 0 at start
+     * @return
+     */
+    uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+    /**
+     * @return whether CRC32C is computed by CPU instruction
+     */
+    bool isHardware();
+
+    /**
+     * Check items in parallel
+     * @param count
+     * @param isValid called once for each index from any thread
+     * @param pool threads to split items between, checked on calling
+     * thread if null
+     * @return indices of invalid items in ascending order
+     */
+    std::vector<size_t> findBroken(size_t count,
+                                   const std::function<bool(size_t)>& isValid,
+                                   ThreadPool* pool = nullptr);
+}
+
+#endif //CHECKSUM_HPP
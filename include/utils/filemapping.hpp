@@ -0,0 +1,58 @@
+#ifndef FILEMAPPING_HPP
+#define FILEMAPPING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils
+{
+    /**
+     * Mapping of whole file, read only by default.
+     * Pages are read by kernel on access, so nothing is copied
+     * until data is touched. Writable mapping is shared, changes
+     * go to file.
+     */
+    class FileMapping
+    {
+    public:
+        /**
+         * Map file, FSException is thrown on errors
+         * @param file
+         * @param writable
+         */
+        explicit FileMapping(const std::string& file, bool writable = false);
+        ~FileMapping();
+
+        FileMapping(const FileMapping&) = delete;
+        FileMapping& operator=(const FileMapping&) = delete;
+
+        const uint8_t* data() const;
+        /**
+         * Data of writable mapping
+         * @return
+         */
+        uint8_t* data();
+        size_t size() const;
+
+        /**
+         * Give kernel advice about part of mapping, part is
+         * widened to whole pages
+         * @param offset
+         * @param size
+         * @param advice MADV_* value
+         */
+        void advise(size_t offset, size_t size, int advice) const;
+
+        /**
+         * Wait until changes are written to file
+         */
+        void sync() const;
+
+    private:
+        void* m_data;
+        size_t m_size;
+    };
+}
+
+#endif //FILEMAPPING_HPP
@@ -0,0 +1,115 @@
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+#include "components/fieldcomponent.hpp"
+
+namespace utils
+{
+    /**
+     * Recent generations of field kept in memory.
+     * Each step is stored as runs of flipped cells with colors of these
+     * cells while they are alive, so the same step is applied forward and
+     * backward. Full keyframes are taken when steps since the last one
+     * take as much memory as keyframe, far seeks start from them. Oldest
+     * steps are dropped when memory budget is exceeded.
+     */
+    class History
+    {
+    public:
+        explicit History(size_t memoryBudget);
+
+        History(const History&) = delete;
+        History& operator=(const History&) = delete;
+
+        /**
+         * Set memory budget in bytes, old steps are dropped on next push
+         * @param memoryBudget
+         */
+        void setMemoryBudget(size_t memoryBudget);
+
+        void clear();
+
+        /**
+         * Remember step to current generation of field.
+         * Only chunks changed in current field version are compared.
+         * Steps after current generation are forgotten, history is
+         * cleared if generation doesn't follow the current one.
+         * @param field
+         * @param prevAlive alive plane of previous generation
+         */
+        void push(const FieldComponent& field,
+                  const std::vector<uint8_t>& prevAlive);
+
+        /**
+         * Show remembered generation
+         * @param generation
+         * @param field field with current generation of history
+         * @return false if generation isn't remembered
+         */
+        bool seek(uint64_t generation, FieldComponent& field);
+
+        bool empty() const;
+        uint64_t getFirstGeneration() const;
+        uint64_t getLastGeneration() const;
+        uint64_t getCurrentGeneration() const;
+        size_t getMemoryUsage() const;
+
+    private:
+        /**
+         * Step from generation - 1 to generation
+         */
+        struct Step
+        {
+            uint64_t generation;
+            // Pairs of zigzag LEB128 gap from previous run end and length
+            std::vector<uint8_t> runs;
+            std::vector<uint32_t> colors;
+        };
+
+        struct Keyframe
+        {
+            uint64_t generation;
+            std::vector<uint8_t> bits;
+            // Colors of live cells in index order
+            std::vector<uint32_t> colors;
+        };
+
+        /**
+         * Flip cells of step, cells which become alive get their colors
+         * @param step
+         * @param field
+         */
+        static void apply(const Step& step, FieldComponent& field);
+        static void restore(const Keyframe& keyframe, FieldComponent& field);
+        static size_t size_of(const Step& step);
+        static size_t size_of(const Keyframe& keyframe);
+
+        void take_keyframe(const FieldComponent& field);
+        /**
+         * Forget steps after current generation
+         */
+        void truncate();
+        void evict();
+        const Step& step(uint64_t generation) const;
+
+        std::deque<Step> m_steps;
+        std::deque<Keyframe> m_keyframes;
+        size_t m_budget;
+        size_t m_used;
+        // Memory of steps after the last keyframe
+        size_t m_sinceKeyframe;
+        // Expected memory of the next keyframe
+        size_t m_keyframeSize;
+        uint64_t m_current;
+
+        // Buffers of step being recorded
+        std::vector<uint8_t> m_runs;
+        std::vector<uint32_t> m_colors;
+    };
+}
+
+#endif //HISTORY_HPP
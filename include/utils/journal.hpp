@@ -0,0 +1,135 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "utils/snapshot.hpp"
+#include "utils/filemapping.hpp"
+#include "utils/threadpool.hpp"
+#include "components/fieldcomponent.hpp"
+
+/**
+ * Journal of simulation generations.
+ * File starts with header, then go records one after another. Keyframe
+ * record holds whole alive plane packed to bits, delta record holds
+ * runs of cells flipped since previous generation. Positions of runs
+ * are coded as LEB128 gaps from the end of previous run. Colors of live
+ * cells change only on birth, so records with colors hold RGB565 colors
+ * of live cells (keyframe) or of born cells (delta) in index order.
+ * Each record has CRC32C of its header and payload, version 1 journals
+ * have no checksums.
+ */
+namespace utils::journal
+{
+    constexpr uint32_t journal_version = 2;
+
+    /**
+     * Append generations of one simulation to journal file.
+     * Every record is flushed, so crashed run leaves readable journal.
+     */
+    class JournalWriter
+    {
+    public:
+        /**
+         * Create journal and write field as first keyframe
+         * @param file
+         * @param field
+         * @param info
+         * @param keyframeInterval generations between keyframes
+         */
+        JournalWriter(const std::string& file, const FieldComponent& field,
+                      const snapshot::SnapshotInfo& info,
+                      size_t keyframeInterval);
+
+        JournalWriter(const JournalWriter&) = delete;
+        JournalWriter& operator=(const JournalWriter&) = delete;
+
+        /**
+         * Write next generation of field
+         * @param field
+         */
+        void append(const FieldComponent& field);
+
+    private:
+        void write_keyframe(const FieldComponent& field);
+        void write_delta(const FieldComponent& field);
+        void write_record(uint32_t type, uint64_t generation);
+
+        std::string m_file;
+        std::ofstream m_out;
+        bool m_hasColors;
+        size_t m_keyframeInterval;
+        size_t m_sinceKeyframe;
+
+        // Alive plane of previously written generation
+        std::vector<uint8_t> m_prev;
+        std::vector<uint8_t> m_payload;
+    };
+
+    /**
+     * Replay of journal from mapping of file
+     */
+    class JournalReader
+    {
+    public:
+        /**
+         * Map journal and find its records. Checksums of all records
+         * are compared, FSException names the first broken record.
+         * Partially written or broken records at the end of file
+         * are ignored, crashed run leaves them.
+         * @param file
+         * @param pool checksums are compared in parallel if it is given
+         */
+        explicit JournalReader(const std::string& file,
+                               ThreadPool* pool = nullptr);
+
+        JournalReader(const JournalReader&) = delete;
+        JournalReader& operator=(const JournalReader&) = delete;
+
+        const snapshot::SnapshotInfo& getInfo() const;
+        uint64_t getFirstGeneration() const;
+        uint64_t getLastGeneration() const;
+
+        /**
+         * Load nearest keyframe before generation and apply deltas
+         * up to it. Generation is clamped to journal range.
+         * @param generation
+         * @param field
+         */
+        void seek(uint64_t generation, FieldComponent& field);
+
+        /**
+         * Apply next record to field
+         * @param field
+         * @return false if journal is over
+         */
+        bool next(FieldComponent& field);
+
+    private:
+        struct Record
+        {
+            uint32_t type;
+            uint32_t checksum;
+            uint64_t generation;
+            const uint8_t* payload;
+            size_t size;
+        };
+
+        void apply_keyframe(const Record& record, FieldComponent& field);
+        void apply_delta(const Record& record, FieldComponent& field);
+
+        std::string m_file;
+        std::unique_ptr<FileMapping> m_mapping;
+        snapshot::SnapshotInfo m_info;
+        size_t m_sizeX, m_sizeY, m_sizeZ;
+        std::vector<Record> m_records;
+        // Record applied last, m_records.size() before first seek
+        size_t m_current;
+    };
+}
+
+#endif //JOURNAL_HPP
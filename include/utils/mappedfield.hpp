@@ -0,0 +1,81 @@
+#ifndef MAPPEDFIELD_HPP
+#define MAPPEDFIELD_HPP
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include "utils/filemapping.hpp"
+#include "utils/snapshot.hpp"
+#include "utils/threadpool.hpp"
+
+namespace utils
+{
+    /**
+     * Field which doesn't fit in memory, simulated right in snapshot file.
+     * Planes along x go one after another in file, so generation is
+     * computed by streaming: only three unpacked planes around the current
+     * one are kept, the next generation is packed to a new file which
+     * replaces the old one. Input is read ahead and dropped behind, so
+     * file is read and written sequentially once per generation.
+     * Colors aren't simulated, new generation is saved without them.
+     * Checksums of input blocks are compared just before blocks are read,
+     * output blocks get checksums right after they are packed.
+     */
+    class MappedField
+    {
+    public:
+        /**
+         * Map snapshot, FSException is thrown on errors
+         * @param file
+         */
+        explicit MappedField(const std::string& file);
+
+        MappedField(const MappedField&) = delete;
+        MappedField& operator=(const MappedField&) = delete;
+
+        /**
+         * Write snapshot of random field, cells are generated plane by plane
+         * @param file
+         * @param sizeX
+         * @param sizeY
+         * @param sizeZ
+         * @param info
+         * @param density probability of cell to be alive
+         * @param seed
+         */
+        static void create(const std::string& file, uint64_t sizeX,
+                           uint64_t sizeY, uint64_t sizeZ,
+                           const snapshot::SnapshotInfo& info, double density,
+                           uint64_t seed);
+
+        /**
+         * Compute next generation, file is replaced when it is done.
+         * FSException is thrown if block of file is broken, file is kept
+         * @param pool rows of each plane are split between threads
+         */
+        void step(ThreadPool& pool);
+
+        const snapshot::SnapshotLayout& getLayout() const;
+
+        /**
+         * @return live cells after the last step
+         */
+        uint64_t getAliveCount() const;
+
+    private:
+        /**
+         * Unpack plane to window buffer with one dead cell border
+         * @param x
+         * @param plane
+         */
+        void read_plane(size_t x, uint8_t* plane) const;
+
+        std::string m_file;
+        snapshot::SnapshotLayout m_layout;
+        std::unique_ptr<FileMapping> m_mapping;
+        uint64_t m_aliveCount;
+    };
+}
+
+#endif //MAPPEDFIELD_HPP
@@ -6,6 +6,8 @@
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
 #include <GL/glew.h>
 
 using glm::vec2;
@@ -79,6 +81,21 @@ namespace utils::math {
         return tr2;
     }
 
+    /**
+     * Distance from point to axis aligned box.
+     * 0 if point is inside box.
+     * @param point
+     * @param min
+     * @param max
+     * @return
+     */
+    inline GLfloat
+    distance_to_box(const glm::vec3& point, const glm::vec3& min,
+                    const glm::vec3& max)
+    {
+        return glm::length(point - glm::clamp(point, min, max));
+    }
+
     template <typename T>
     constexpr glm::vec2 operator/(T val, const glm::vec2& vec)
     {
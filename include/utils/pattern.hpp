@@ -0,0 +1,52 @@
+#ifndef PATTERN_HPP
+#define PATTERN_HPP
+
+#include <string>
+#include <glm/vec3.hpp>
+
+#include "components/fieldcomponent.hpp"
+
+/**
+ * Import of initial patterns. Files are parsed block by block and cells
+ * are placed right away, so time depends on pattern size only.
+ */
+namespace utils::pattern
+{
+    enum class PatternFormat
+    {
+        // Golly 3D RLE: o is alive, b is dead, $ ends row, / ends plane
+        RLE,
+        // MagicaVoxel .vox, colors are taken from palette
+        VOX,
+        // Text lines with x y z of live cells
+        COORDINATES
+    };
+
+    struct PlaceResult
+    {
+        size_t placed = 0;
+        // Cells out of field
+        size_t clipped = 0;
+    };
+
+    /**
+     * Guess format by file extension, unknown files are coordinates
+     * @param file
+     * @return
+     */
+    PatternFormat detectFormat(const std::string& file);
+
+    /**
+     * Make cells of pattern alive in field.
+     * Cells out of field are skipped, changed chunks are marked.
+     * Cells read before broken part of file stay in field.
+     * @param file
+     * @param field
+     * @param offset position of pattern origin in field
+     * @return
+     */
+    PlaceResult place(const std::string& file, FieldComponent& field,
+                      const glm::ivec3& offset);
+}
+
+#endif //PATTERN_HPP
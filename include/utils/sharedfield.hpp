@@ -0,0 +1,251 @@
+#ifndef SHAREDFIELD_HPP
+#define SHAREDFIELD_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Field published to POSIX shared memory for other processes.
+ * Segment starts with header, then go two slots, each with alive plane
+ * (byte 0 or 1 per cell) and RGBA8 colors in field index order
+ * (x * sizeY + y) * sizeZ + z. Writer fills the older slot and makes it
+ * the latest one, every slot is guarded by sequence counter which is odd
+ * while slot is written (seqlock). Readers never block writer, they check
+ * sequence after reading and retry if slot was changed.
+ * This header doesn't depend on the game, so tools include it alone.
+ */
+namespace utils::sharedfield
+{
+    constexpr uint32_t shared_version = 1;
+    constexpr char shared_magic[8] = {'L', 'I', 'F', 'E', 'S', 'H', 'M', '1'};
+    constexpr size_t slots_count = 2;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "Shared counters must work between processes");
+
+    struct SlotHeader
+    {
+        // Odd while slot is written
+        std::atomic<uint64_t> sequence;
+        uint64_t generation;
+    };
+
+    struct SharedFieldHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t sizeX;
+        uint64_t sizeY;
+        uint64_t sizeZ;
+        // From segment start
+        uint64_t slotOffsets[slots_count];
+        // From slot start
+        uint64_t aliveOffset;
+        uint64_t colorsOffset;
+        // Slot with the newest complete generation
+        std::atomic<uint64_t> latest;
+        // Set when writer removes segment, e.g. field is resized
+        std::atomic<uint64_t> stale;
+    };
+
+    /**
+     * Planes of slot, valid only while slot isn't rewritten
+     */
+    struct FieldView
+    {
+        uint64_t generation;
+        uint64_t sizeX;
+        uint64_t sizeY;
+        uint64_t sizeZ;
+        const uint8_t* alive;
+        const uint32_t* colors;
+    };
+
+    enum class ReadStatus
+    {
+        OK,
+        // Writer was faster on every try
+        BUSY,
+        // Segment isn't published anymore, reader should open it again
+        STALE
+    };
+
+    /**
+     * Read only mapping of published field
+     */
+    class SharedFieldReader
+    {
+    public:
+        SharedFieldReader() : m_data(nullptr), m_size(0)
+        {}
+
+        ~SharedFieldReader()
+        {
+            close();
+        }
+
+        SharedFieldReader(const SharedFieldReader&) = delete;
+        SharedFieldReader& operator=(const SharedFieldReader&) = delete;
+
+        /**
+         * Map segment, previous one is unmapped
+         * @param name shared memory name, e.g. /lifegame_field
+         * @return false if segment doesn't exist or isn't a field
+         */
+        bool open(const std::string& name)
+        {
+            close();
+            int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd == -1)
+                return false;
+
+            struct stat st{};
+            void* data = MAP_FAILED;
+            if (fstat(fd, &st) == 0
+                && static_cast<size_t>(st.st_size) >= sizeof(SharedFieldHeader))
+                data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED)
+                return false;
+
+            m_data = static_cast<const uint8_t*>(data);
+            m_size = st.st_size;
+            if (!is_valid()) {
+                close();
+                return false;
+            }
+
+            return true;
+        }
+
+        void close()
+        {
+            if (m_data)
+                munmap(const_cast<uint8_t*>(m_data), m_size);
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        bool isOpen() const
+        {
+            return m_data != nullptr;
+        }
+
+        /**
+         * @return generation of the latest slot, it may be written already
+         */
+        uint64_t latestGeneration() const
+        {
+            return slot(header().latest.load(std::memory_order_acquire))
+                    .generation;
+        }
+
+        /**
+         * Give the latest generation to f without copying. Result of f must
+         * be dropped unless OK is returned, slot could change meanwhile.
+         * Writer needs a whole generation to come back to slot, so f may
+         * take about step time.
+         * @param f callable with const FieldView&
+         * @param tries
+         * @return
+         */
+        template <typename F>
+        ReadStatus read(F&& f, size_t tries = 16) const
+        {
+            for (size_t i = 0; i < tries; ++i) {
+                if (header().stale.load(std::memory_order_acquire))
+                    return ReadStatus::STALE;
+
+                const size_t idx = header().latest.load(
+                        std::memory_order_acquire) % slots_count;
+                const SlotHeader& s = slot(idx);
+                const uint64_t sequence = s.sequence.load(
+                        std::memory_order_acquire);
+                // Nothing is published to slot yet or it is written now
+                if (sequence == 0 || sequence % 2) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                const uint8_t* base = m_data + header().slotOffsets[idx];
+                f(FieldView{s.generation, header().sizeX, header().sizeY,
+                            header().sizeZ, base + header().aliveOffset,
+                            reinterpret_cast<const uint32_t*>(
+                                    base + header().colorsOffset)});
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.sequence.load(std::memory_order_relaxed) == sequence)
+                    return ReadStatus::OK;
+            }
+
+            return ReadStatus::BUSY;
+        }
+
+        /**
+         * Copy consistent latest generation
+         * @param alive
+         * @param colors
+         * @param generation
+         * @param tries
+         * @return
+         */
+        template <typename AliveContainer, typename ColorsContainer>
+        ReadStatus copy(AliveContainer& alive, ColorsContainer& colors,
+                        uint64_t& generation, size_t tries = 16) const
+        {
+            return read([&](const FieldView& view) {
+                const size_t cells = view.sizeX * view.sizeY * view.sizeZ;
+                alive.resize(cells);
+                colors.resize(cells);
+                std::memcpy(alive.data(), view.alive, cells);
+                std::memcpy(colors.data(), view.colors,
+                            cells * sizeof(uint32_t));
+                generation = view.generation;
+            }, tries);
+        }
+
+    private:
+        const SharedFieldHeader& header() const
+        {
+            return *reinterpret_cast<const SharedFieldHeader*>(m_data);
+        }
+
+        const SlotHeader& slot(size_t idx) const
+        {
+            return *reinterpret_cast<const SlotHeader*>(
+                    m_data + header().slotOffsets[idx % slots_count]);
+        }
+
+        bool is_valid() const
+        {
+            const SharedFieldHeader& h = header();
+            if (std::memcmp(h.magic, shared_magic, sizeof(shared_magic))
+                || h.version != shared_version
+                || h.headerSize != sizeof(SharedFieldHeader))
+                return false;
+
+            const uint64_t cells = h.sizeX * h.sizeY * h.sizeZ;
+            for (uint64_t offset: h.slotOffsets)
+                if (offset > m_size
+                    || h.colorsOffset + cells * sizeof(uint32_t)
+                       > m_size - offset
+                    || h.aliveOffset + cells > h.colorsOffset)
+                    return false;
+
+            return true;
+        }
+
+        const uint8_t* m_data;
+        size_t m_size;
+    };
+}
+
+#endif //SHAREDFIELD_HPP
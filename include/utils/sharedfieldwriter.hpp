@@ -0,0 +1,47 @@
+#ifndef SHAREDFIELDWRITER_HPP
+#define SHAREDFIELDWRITER_HPP
+
+#include <string>
+
+#include "utils/sharedfield.hpp"
+#include "components/fieldcomponent.hpp"
+
+namespace utils::sharedfield
+{
+    /**
+     * Owner of shared memory segment with published field.
+     * Segment is removed in destructor, mapped readers see it stale.
+     */
+    class SharedFieldWriter
+    {
+    public:
+        /**
+         * @param name shared memory name, e.g. /lifegame_field
+         */
+        explicit SharedFieldWriter(std::string name);
+        ~SharedFieldWriter();
+
+        SharedFieldWriter(const SharedFieldWriter&) = delete;
+        SharedFieldWriter& operator=(const SharedFieldWriter&) = delete;
+
+        /**
+         * Copy field to the older slot and make it the latest one.
+         * Segment is created again if field size is changed.
+         * FSException is thrown if segment can't be created.
+         * @param field
+         */
+        void publish(const FieldComponent& field);
+
+    private:
+        void create(const FieldComponent& field);
+        void remove();
+
+        SharedFieldHeader& header();
+
+        std::string m_name;
+        uint8_t* m_data;
+        size_t m_size;
+    };
+}
+
+#endif //SHAREDFIELDWRITER_HPP
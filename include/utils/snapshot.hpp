@@ -0,0 +1,246 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "components/fieldcomponent.hpp"
+#include "utils/threadpool.hpp"
+
+/**
+ * Binary snapshot of simulation.
+ * File starts with fixed size header, then go alive plane with one bit
+ * per cell in index order, optional color plane with RGB565 color of each
+ * live cell, chunk index and checksums of alive plane. Index has
+ * population and bounding box of live cells of each chunk and offset of
+ * its colors, so only chunks with live cells are decoded. Colors go chunk by chunk, in order of live
+ * cells of chunk bounding box. Header, each index entry with colors of
+ * its chunk and each 64 KiB block of alive plane have CRC32C, so broken
+ * part is found before it gets to field. Version 1 files have no index
+ * and colors go in index order, version 2 files have no checksums.
+ * Planes are aligned to 64 bytes.
+ * All numbers are little endian.
+ */
+namespace utils::snapshot
+{
+    constexpr uint32_t snapshot_version = 3;
+
+    /**
+     * What happens with neighbours out of field
+     */
+    enum class Boundary : uint32_t
+    {
+        DEAD = 0
+    };
+
+    /**
+     * Simulation parameters stored with field
+     */
+    struct SnapshotInfo
+    {
+        // Neighbours count to become alive and to die
+        uint32_t neirCount;
+        uint32_t neirCountDie;
+        Boundary boundary = Boundary::DEAD;
+        bool hasColors = false;
+    };
+
+    /**
+     * Part of field, from x, y, z with given sizes
+     */
+    struct Region
+    {
+        uint64_t x;
+        uint64_t y;
+        uint64_t z;
+        uint64_t sizeX;
+        uint64_t sizeY;
+        uint64_t sizeZ;
+    };
+
+    /**
+     * Chunk with live cells from snapshot index
+     */
+    struct ChunkSummary
+    {
+        // The first cell of chunk
+        uint64_t x;
+        uint64_t y;
+        uint64_t z;
+        uint32_t population;
+        // Bounding box of live cells, inclusive
+        uint64_t minX;
+        uint64_t minY;
+        uint64_t minZ;
+        uint64_t maxX;
+        uint64_t maxY;
+        uint64_t maxZ;
+    };
+
+    /**
+     * Where field lies in snapshot file
+     */
+    struct SnapshotLayout
+    {
+        uint64_t sizeX;
+        uint64_t sizeY;
+        uint64_t sizeZ;
+        uint64_t generation;
+        SnapshotInfo info;
+        // Alive plane position from file start in bytes
+        uint64_t aliveOffset;
+        uint64_t aliveSize;
+        // Bytes of alive plane per checksum, 0 if file has no checksums
+        uint32_t checksumBlock;
+        uint64_t checksumsOffset;
+    };
+
+    /**
+     * Pack cells to bits, first cell goes to the lowest bit of first byte
+     * @param cells alive plane, any non zero cell is alive
+     * @param count
+     * @param bits (count + 7) / 8 bytes, unused bits are zero
+     * @return count of live cells
+     */
+    size_t pack_alive(const uint8_t* cells, size_t count, uint8_t* bits);
+
+    /**
+     * Unpack bits to cells with 0 or 1
+     * @param bits
+     * @param count
+     * @param cells
+     */
+    void unpack_alive(const uint8_t* bits, size_t count, uint8_t* cells);
+
+    /**
+     * Unpack bits starting at any bit to cells with 0 or 1
+     * @param bits
+     * @param offset first bit
+     * @param count
+     * @param cells
+     */
+    void unpack_bits(const uint8_t* bits, size_t offset, size_t count,
+                     uint8_t* cells);
+
+    /**
+     * Quantize RGBA8 color, alpha is dropped
+     * @param color
+     * @return
+     */
+    uint16_t to_rgb565(uint32_t color);
+
+    /**
+     * Expand RGB565 color to opaque RGBA8
+     * @param color
+     * @return
+     */
+    uint32_t from_rgb565(uint16_t color);
+
+    /**
+     * Write field to file block by block. Blocks are packed while
+     * previous ones are written asynchronously.
+     * Colors are quantized to RGB565 and written only for live cells.
+     * @param file
+     * @param field
+     * @param info
+     * @param directIo bypass page cache where file system allows it
+     */
+    void save(const std::string& file, const FieldComponent& field,
+              const SnapshotInfo& info, bool directIo = false);
+
+    /**
+     * Map file and unpack planes from mapping to field.
+     * Field is resized, its generation is restored. Cells without
+     * colors get white color. Only chunks with live cells are read
+     * if file has chunk index. Checksums of read parts are compared
+     * before field is changed, FSException names broken chunk or block.
+     * Field isn't changed if file is broken, except when alive plane
+     * of file without checksums contradicts index, then it is left dead.
+     * @param file
+     * @param field
+     * @param pool checksums are compared in parallel if it is given
+     * @return parameters of saved simulation
+     */
+    SnapshotInfo load(const std::string& file, FieldComponent& field,
+                      ThreadPool* pool = nullptr);
+
+    /**
+     * Load part of field, chunks out of region aren't read.
+     * Region is clipped by field, field is resized to clipped region.
+     * Files without chunk index are decoded whole and cut.
+     * Checksums are compared only for read chunks.
+     * @param file
+     * @param field
+     * @param region
+     * @param pool checksums are compared in parallel if it is given
+     * @return parameters of saved simulation
+     */
+    SnapshotInfo loadRegion(const std::string& file, FieldComponent& field,
+                            const Region& region, ThreadPool* pool = nullptr);
+
+    /**
+     * Read chunk index without decoding cells
+     * @param file
+     * @return chunks with live cells
+     */
+    std::vector<ChunkSummary> readIndex(const std::string& file);
+
+    /**
+     * Read and check header only, planes aren't read
+     * @param file
+     * @return
+     */
+    SnapshotLayout readLayout(const std::string& file);
+
+    /**
+     * Write snapshot of empty field without colors. Alive plane
+     * isn't written, file is extended with zeros, so it is sparse
+     * on most file systems. Checksums of blocks are left zero,
+     * they are written by writeChecksums() when plane is filled.
+     * @param file
+     * @param sizeX
+     * @param sizeY
+     * @param sizeZ
+     * @param generation
+     * @param info
+     * @return layout of new file
+     */
+    SnapshotLayout create(const std::string& file, uint64_t sizeX,
+                          uint64_t sizeY, uint64_t sizeZ, uint64_t generation,
+                          const SnapshotInfo& info);
+
+    /**
+     * @param layout
+     * @return count of alive plane blocks with checksums
+     */
+    uint64_t blocksCount(const SnapshotLayout& layout);
+
+    /**
+     * Compare checksums of alive plane blocks of mapped snapshot.
+     * Nothing is checked if file has no checksums.
+     * FSException names the first broken block and planes it covers.
+     * @param file name for errors
+     * @param data mapping of file
+     * @param layout
+     * @param first block
+     * @param last block after the last checked one
+     * @param pool checksums are compared in parallel if it is given
+     */
+    void checkBlocks(const std::string& file, const uint8_t* data,
+                     const SnapshotLayout& layout, uint64_t first,
+                     uint64_t last, ThreadPool* pool = nullptr);
+
+    /**
+     * Compute checksums of alive plane blocks of writable mapping
+     * of snapshot made by create(), blocks must be filled already
+     * @param data mapping of file
+     * @param layout
+     * @param first block
+     * @param last block after the last computed one
+     */
+    void writeChecksums(uint8_t* data, const SnapshotLayout& layout,
+                        uint64_t first, uint64_t last);
+}
+
+#endif //SNAPSHOT_HPP
@@ -1,6 +1,10 @@
 #ifndef UTILS_TEXTURE_HPP
 #define UTILS_TEXTURE_HPP
 
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
 namespace utils::texture {
         /**
      * Load opengl texture from pixels to GPU with specific format.
@@ -17,14 +21,33 @@ namespace utils::texture {
                                 GLenum textureType = GL_RGBA);
 
     /**
-     * Parse obj file
-     * Return vector with such elements in row:
-     * <ver.x, ver.y, ver.z, uv.x, uv.y>
+     * Indexed mesh.
+     * Vertices go in rows <ver.x, ver.y, ver.z, uv.x, uv.y>,
+     * each pair of position and uv is stored once.
+     */
+    struct Mesh
+    {
+        std::vector<GLfloat> vertices;
+        std::vector<GLuint> indices;
+        std::string textureFile;
+    };
+
+    /**
+     * Parse obj file. Polygons are split to triangles.
+     * Texture file is taken from map_Kd of mtl file.
+     * @param file
+     * @return
+     */
+    Mesh loadObj(const std::string &file);
+
+    /**
+     * Load mesh from binary cache next to obj file (file.meshcache).
+     * If cache is missing or older than obj, obj is parsed and
+     * cache is rewritten.
      * @param file
      * @return
      */
-    std::vector <GLfloat> loadObj(const std::string &file,
-                                  std::string &textureFile);
+    Mesh loadMesh(const std::string &file);
 
     /**
      * Load texture from file
@@ -0,0 +1,61 @@
+#ifndef VARINT_HPP
+#define VARINT_HPP
+
+#include <vector>
+#include <cstdint>
+
+namespace utils
+{
+    /**
+     * Append LEB128 coded number, 7 bits per byte
+     * @param out
+     * @param val
+     */
+    inline void put_varint(std::vector<uint8_t>& out, uint64_t val)
+    {
+        while (val >= 0x80) {
+            out.push_back(static_cast<uint8_t>(val | 0x80));
+            val >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(val));
+    }
+
+    /**
+     * Read LEB128 coded number and move data after it
+     * @param data
+     * @param end
+     * @param val
+     * @return false if number is truncated or too long
+     */
+    inline bool get_varint(const uint8_t*& data, const uint8_t* end,
+                           uint64_t& val)
+    {
+        val = 0;
+        for (unsigned shift = 0; shift < 64 && data != end; shift += 7) {
+            uint8_t byte = *data++;
+            val |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * Map signed number to unsigned one, small by modulo numbers
+     * stay small
+     * @param val
+     * @return
+     */
+    inline uint64_t zigzag(int64_t val)
+    {
+        return static_cast<uint64_t>(val) << 1 ^ static_cast<uint64_t>(val >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t val)
+    {
+        return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+    }
+}
+
+#endif //VARINT_HPP
@@ -3,9 +3,10 @@
 
 #include <unordered_map>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 #include <SDL_ttf.h>
-#include <boost/multi_array.hpp>
 
 #include "utils/fps.hpp"
 #include "utils/timer.hpp"
@@ -16,23 +17,18 @@
 #include "utils/audio.hpp"
 #include "ecs/ecsmanager.hpp"
 #include "utils/threadpool.hpp"
-#include "components/cellcomponent.hpp"
+#include "components/fieldcomponent.hpp"
+#include "utils/snapshot.hpp"
+#include "utils/checkpointer.hpp"
+#include "utils/journal.hpp"
+#include "utils/history.hpp"
+#include "utils/sharedfieldwriter.hpp"
 
 /**
  * To avoid circular including
  */
 class Component;
 
-struct CellState
-{
-    bool alive;
-    glm::vec4 color;
-};
-
-typedef boost::multi_array<std::shared_ptr<CellComponent>, 3> Field;
-typedef boost::multi_array<CellState, 3> FieldState;
-typedef Field::index CellIndex;
-
 class World: public ecs::EcsManager
 {
 public:
@@ -48,18 +44,94 @@ private:
 
     void update_field();
     void init_field();
+    /**
+     * Kill all cells of field and give them random colors
+     */
+    void clear_field();
+
+    /**
+     * Write field to snapshot file from config
+     */
+    void save_simulation();
+    /**
+     * Replace field with snapshot file from config and pause
+     * simulation. Errors are logged, field stays untouched then.
+     */
+    void load_simulation();
+    /**
+     * Show loaded field and pause simulation on it
+     * @param info
+     */
+    void restore_field(const utils::snapshot::SnapshotInfo& info);
+    /**
+     * Replace field with the newest valid checkpoint if there is one
+     */
+    void resume_checkpoint();
+    /**
+     * Queue checkpoint of current generation
+     */
+    void checkpoint_field();
+    void place_camera();
+    /**
+     * Place pattern file from config to field
+     * @return false if there is no pattern or it can't be read,
+     * field is cleared then
+     */
+    bool place_pattern();
+    /**
+     * Start new journal from current field if recording is enabled.
+     * It is called on the first simulated generation, not on init,
+     * so journal isn't truncated before it can be replayed
+     */
+    void start_recording();
+    /**
+     * Show first generation of journal from config, next
+     * generations are read from journal instead of simulation
+     */
+    void start_replay();
+    /**
+     * Show next generation of replayed journal
+     */
+    void replay_field();
+    /**
+     * Show generation from history and pause simulation on it
+     * @param generation
+     */
+    void seek_history(uint64_t generation);
+    /**
+     * Let gui know generations of history
+     */
+    void publish_history();
+    /**
+     * Copy changed field to shared memory from config
+     */
+    void publish_field();
 
     /**
      * Remove all entities that not alive
      */
     void filter_entities();
 
-    Field m_cells;
+    std::shared_ptr<FieldComponent> m_field;
+    // Next generation planes, swapped with field ones after step
+    std::vector<uint8_t> m_nextAlive;
+    std::vector<uint32_t> m_nextColors;
     size_t m_fieldSize;
-
-    ThreadPool m_pool;
+    // Created on first checkpoint
+    std::unique_ptr<utils::Checkpointer> m_checkpointer;
+    // Set while recording or replay goes
+    std::unique_ptr<utils::journal::JournalWriter> m_journalWriter;
+    std::unique_ptr<utils::journal::JournalReader> m_journalReader;
+    // Recent generations for step back, budget is set on each push
+    utils::History m_history;
+    // Field published for other processes and its last copied version
+    std::unique_ptr<utils::sharedfield::SharedFieldWriter> m_sharedField;
+    std::string m_sharedFieldName;
+    std::optional<uint64_t> m_sharedVersion;
 
     bool m_wasInit;
+    // Journal is started by next simulated generation
+    bool m_recordPending;
 };
 
 #endif //MOONLANDER_WORLD_HPP
@@ -1,8 +1,11 @@
 #include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <boost/format.hpp>
+#include <utility>
 
 #include "game.hpp"
 #include "config.hpp"
@@ -10,6 +13,7 @@
 #include "exceptions/sdlexception.hpp"
 #include "exceptions/glexception.hpp"
 #include "utils/utils.hpp"
+#include "render/streambuffer.hpp"
 
 //#define INIT_SOUND
 
@@ -27,6 +31,14 @@ static bool mixerInit = false;
 static bool isRun = true;
 static GameStates state = GameStates::STOP;
 static GameStates prevState = GameStates::STOP;
+static bool sceneDirty = true;
+static HeadlessOptions headlessOptions;
+static SimulationRequest simulationRequest = SimulationRequest::NONE;
+static HistoryRange historyRange;
+static std::optional<uint64_t> historySeek;
+
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLContext eglContext = EGL_NO_CONTEXT;
 
 SDL_Window* Game::m_window = nullptr;
 SDL_GLContext Game::m_glcontext = nullptr;
@@ -40,6 +52,16 @@ void quit()
 {
     if (Game::getGLContext())
         SDL_GL_DeleteContext(Game::getGLContext());
+    if (eglContext != EGL_NO_CONTEXT) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                       EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglContext = EGL_NO_CONTEXT;
+    }
+    if (eglDisplay != EGL_NO_DISPLAY) {
+        eglTerminate(eglDisplay);
+        eglDisplay = EGL_NO_DISPLAY;
+    }
     if (TTF_WasInit())
         TTF_Quit();
     if (imgInit)
@@ -73,6 +95,7 @@ void setGameState(GameStates st)
 {
     prevState = state;
     state = st;
+    sceneDirty = true;
 }
 
 GameStates getPrevGameState()
@@ -80,6 +103,74 @@ GameStates getPrevGameState()
     return prevState;
 }
 
+void markSceneDirty()
+{
+    sceneDirty = true;
+}
+
+bool isSceneDirty()
+{
+    return sceneDirty;
+}
+
+void clearSceneDirty()
+{
+    sceneDirty = false;
+}
+
+void requestSimulation(SimulationRequest request)
+{
+    simulationRequest = request;
+}
+
+SimulationRequest takeSimulationRequest()
+{
+    return std::exchange(simulationRequest, SimulationRequest::NONE);
+}
+
+void setHistoryRange(const HistoryRange& range)
+{
+    historyRange = range;
+}
+
+const HistoryRange& getHistoryRange()
+{
+    return historyRange;
+}
+
+void requestHistorySeek(uint64_t generation)
+{
+    historySeek = generation;
+}
+
+std::optional<uint64_t> takeHistorySeek()
+{
+    return std::exchange(historySeek, std::nullopt);
+}
+
+void setHeadlessOptions(const HeadlessOptions& options)
+{
+    headlessOptions = options;
+}
+
+const HeadlessOptions& getHeadlessOptions()
+{
+    return headlessOptions;
+}
+
+bool isHeadless()
+{
+    return headlessOptions.enabled;
+}
+
+glm::ivec2 getFrameSize()
+{
+    if (isHeadless())
+        return {headlessOptions.width, headlessOptions.height};
+
+    return {utils::getDisplayWidth<int>(), utils::getDisplayHeight<int>()};
+}
+
 
 void Game::initOnceSDL2()
 {
@@ -88,7 +179,9 @@ void Game::initOnceSDL2()
     if (didInit)
         return;
 
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0)
+    // Headless mode needs SDL only for images and fonts
+    Uint32 flags = isHeadless() ? 0 : SDL_INIT_VIDEO | SDL_INIT_AUDIO;
+    if (SDL_Init(flags) != 0)
         throw SdlException((format("SDL initialization error: %1%\n")
                             % SDL_GetError()).str(),
                            program_log_file_name(),
@@ -134,6 +227,10 @@ void Game::initOnceSDL2()
                             Config::getVal<int>("MSAASamples"));
     }
 
+    didInit = true;
+    if (isHeadless())
+        return;
+
     SDL_SetHint(SDL_HINT_VIDEO_X11_NET_WM_BYPASS_COMPOSITOR, "0");
 
     SDL_ShowCursor(SDL_ENABLE);
@@ -156,7 +253,7 @@ void Game::update(size_t delta)
     m_world.update(delta);
 }
 
-void Game::initGL()
+void Game::create_window_context()
 {
     auto screenWidth = utils::getDisplayWidth<GLuint>();
     auto screenHeight = utils::getDisplayHeight<GLuint>();
@@ -179,9 +276,63 @@ void Game::initGL()
                            program_log_file_name(),
                            Category::INITIALIZATION_ERROR);
 
+}
+
+void Game::create_headless_context()
+{
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    // Surfaceless platform doesn't need display server
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, nullptr);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+        throw GLException((format("Unable to initialize egl display. "
+                                  "EGL Error: %#x\n") % eglGetError()).str(),
+                          program_log_file_name(),
+                          Category::INITIALIZATION_ERROR);
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+        throw GLException((format("Unable to bind opengl api. "
+                                  "EGL Error: %#x\n") % eglGetError()).str(),
+                          program_log_file_name(),
+                          Category::INITIALIZATION_ERROR);
+
+    const EGLint attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,
+            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+    };
+    eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR,
+                                  EGL_NO_CONTEXT, attributes);
+    if (eglContext == EGL_NO_CONTEXT
+        || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                           eglContext))
+        throw GLException((format("Unable to create surfaceless gl context. "
+                                  "EGL Error: %#x\n") % eglGetError()).str(),
+                          program_log_file_name(),
+                          Category::INITIALIZATION_ERROR);
+}
+
+void Game::initGL()
+{
+    if (isHeadless())
+        create_headless_context();
+    else
+        create_window_context();
+
     glewExperimental = GL_TRUE;
     GLenum error = glewInit();
-    if (error != GLEW_OK)
+    // Glew built for glx can't query glx extensions with egl context,
+    // gl functions are loaded anyway
+    if (error != GLEW_OK
+        && !(isHeadless() && error == GLEW_ERROR_NO_GLX_DISPLAY))
         throw SdlException((format("Error when initializing GLEW: %s\n")
                             % glewGetErrorString(error)).str(),
                            program_log_file_name(),
@@ -209,7 +360,10 @@ void Game::initGL()
     glEnable(GL_DEPTH_TEST);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     //Use Vsync
-    if(SDL_GL_SetSwapInterval(-1) < 0) {
+    if (isHeadless()) {
+        // Frames are never shown
+        vsync_supported = false;
+    } else if(SDL_GL_SetSwapInterval(-1) < 0) {
         Logger::write(program_log_file_name(),
                       Category::INITIALIZATION_ERROR,
                       (format("Warning: Unable to enable VSync. "
@@ -233,8 +387,11 @@ void Game::initGL()
 
 void Game::flush()
 {
+    // Parts of stream buffer written in this frame are fenced
+    StreamBuffer::getInstance()->nextFrame();
     glFlush();
-    SDL_GL_SwapWindow(Game::m_window);
+    if (!isHeadless())
+        SDL_GL_SwapWindow(Game::m_window);
 }
 
 void Game::initGame()
@@ -1,5 +1,4 @@
 #include <GL/glew.h>
-#include <glm/gtc/type_ptr.hpp>
 
 #include "utils/utils.hpp"
 #include "boost/format.hpp"
@@ -100,8 +99,7 @@ void LifeProgram::loadProgram()
 {
     // Create framebuffer program
     m_frameBufProg = create_program("framebuffer/LifeGame.glvs",
-                                    "framebuffer/LifeGame.glfs",
-                                    "framebuffer/LifeGame.glgs");
+                                    "framebuffer/LifeGame.glfs");
 
     // Get block indices
     GLuint matrixLoc = glGetUniformBlockIndex(m_frameBufProg, "Matrices");
@@ -109,18 +107,20 @@ void LifeProgram::loadProgram()
     // Link shader's uniform block to uniform binding point
     glUniformBlockBinding(m_frameBufProg, matrixLoc, 0); // Matrices
 
-    // Create matrices buffer
-    glGenBuffers(1, &m_matricesUBO);
-    glBindBuffer(GL_UNIFORM_BUFFER, m_matricesUBO);
-    glBufferData(GL_UNIFORM_BUFFER, 3 * sizeof(mat4), nullptr, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    // Bind matrices to 0 index in binding point array
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_matricesUBO);
+    // Create matrices ring, each update of matrices takes next part
+    // of stream buffer which is bound to 0 index in binding point array
+    m_matricesRing = std::make_unique<UniformRing>(StreamBuffer::getInstance());
 
     // Create screen program
     m_screenProg = create_program("screen/LifeGame.glvs",
                                   "screen/LifeGame.glfs");
 
+    // Create surface program, it shares matrices with framebuffer program
+    m_surfaceProg = create_program("framebuffer/Surface.glvs",
+                                   "framebuffer/Surface.glfs");
+    matrixLoc = glGetUniformBlockIndex(m_surfaceProg, "Matrices");
+    glUniformBlockBinding(m_surfaceProg, matrixLoc, 0);
+
     useFramebufferProgram();
     rebindUniforms();
     setTexture(0);
@@ -139,7 +139,7 @@ LifeProgram::~LifeProgram()
 
 void LifeProgram::rebindUniforms()
 {
-    m_texLoc = glGetUniformLocation(m_programID, textureNumberGL);
+    m_texLoc = getUniformLocation(textureNumberGL);
     if (m_texLoc == -1) {
         utils::log::printProgramLog(m_programID);
         throw GLException((format("%s is not a valid glsl program variable!\n")
@@ -160,72 +160,46 @@ void LifeProgram::remove_programs()
         glDeleteProgram(m_screenProg);
         m_screenProg = 0;
     }
+
+    if (glIsProgram(m_surfaceProg)) {
+        glDeleteProgram(m_surfaceProg);
+        m_surfaceProg = 0;
+    }
+
+    m_uniformLocations.clear();
 }
 
 void LifeProgram::free_buffers()
 {
-    glDeleteBuffers(1, &m_matricesUBO);
+    m_matricesRing.reset();
     glDeleteBuffers(1, &m_textureDataUBO);
 
-    m_matricesUBO = m_textureDataUBO = 0;
+    m_textureDataUBO = 0;
 }
 
-void LifeProgram::updateProjection()
+void LifeProgram::upload_matrices()
 {
-    if (m_programID != m_frameBufProg)
+    // Matrices are used only by programs which draw to framebuffer
+    if (m_programID == m_screenProg || !m_matricesRing)
         return;
 
-    glBindBuffer(GL_UNIFORM_BUFFER, m_matricesUBO);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0,
-                    sizeof(glm::mat4), glm::value_ptr(m_projectionMatrix));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    const mat4 matrices[3] = {m_projectionMatrix, m_viewMatrix, m_modelMatrix};
+    m_matricesRing->bind(0, matrices, sizeof(matrices));
+}
 
-    if (GLenum error = glGetError(); error != GL_NO_ERROR) {
-        utils::log::printProgramLog(m_programID);
-        throw GLException((format("Error while updating matricesUBO(m_projectionMatrix)! %s\n")
-                           % gluErrorString(error)).str(),
-                          program_log_file_name(),
-                          Category::INTERNAL_ERROR);
-    }
+void LifeProgram::updateProjection()
+{
+    upload_matrices();
 }
 
 void LifeProgram::updateModel()
 {
-    if (m_programID != m_frameBufProg)
-        return;
-
-    glBindBuffer(GL_UNIFORM_BUFFER, m_matricesUBO);
-    glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4),
-                    sizeof(glm::mat4), glm::value_ptr(m_modelMatrix));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-    if (GLenum error = glGetError(); error != GL_NO_ERROR) {
-        utils::log::printProgramLog(m_programID);
-        throw GLException((format("Error while updating matricesUBO(m_modelMatrix)! %s\n")
-                           % gluErrorString(error)).str(),
-                          program_log_file_name(),
-                          Category::INTERNAL_ERROR);
-    }
+    upload_matrices();
 }
 
 void LifeProgram::updateView()
 {
-    if (m_programID != m_frameBufProg)
-        return;
-
-    glBindBuffer(GL_UNIFORM_BUFFER, m_matricesUBO);
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mat4),
-                    sizeof(mat4), glm::value_ptr(m_viewMatrix));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-    if (GLenum error = glGetError(); error != GL_NO_ERROR) {
-        utils::log::printProgramLog(m_programID);
-        throw GLException((format("Error while updating"
-                                  " matricesUBO(m_viewMatrix)! %s\n")
-                           % gluErrorString(error)).str(),
-                          program_log_file_name(),
-                          Category::INTERNAL_ERROR);
-    }
+    upload_matrices();
 }
 
 void LifeProgram::useScreenProgram()
@@ -244,4 +218,13 @@ void LifeProgram::useFramebufferProgram()
         m_programID = m_frameBufProg;
         rebindUniforms();
     }
+}
+
+void LifeProgram::useSurfaceProgram()
+{
+    // Surface isn't textured, so there is nothing to rebind
+    if (m_programID != m_surfaceProg) {
+        glUseProgram(m_surfaceProg);
+        m_programID = m_surfaceProg;
+    }
 }
\ No newline at end of file
@@ -1,11 +1,16 @@
 #include <SDL2/SDL.h>
 #include <boost/format.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
 
 #include "game.hpp"
 #include "utils/logger.hpp"
 #include "exceptions/basegameexception.hpp"
 #include "lifeprogram.hpp"
 #include "config.hpp"
+#include "base.hpp"
+#include "utils/mappedfield.hpp"
 
 #ifndef NDEBUG // use callgrind profiler
 #include <valgrind/callgrind.h>
@@ -14,6 +19,154 @@
 using utils::log::program_log_file_name;
 using utils::log::Category;
 
+const char* usage =
+        "Usage: LifeGame [--headless] [--frames N] [--size WxH]\n"
+        "                [--format png|y4m] [--output path] [--fps N]\n"
+        "                [--replay journal]\n"
+        "       LifeGame --out-of-core snapshot [--generations N]\n"
+        "                [--create N] [--density P]\n";
+
+/**
+ * Simulation of snapshot file without window and rendering
+ */
+struct OutOfCoreOptions
+{
+    // Empty file disables out of core run
+    std::string file;
+    size_t generations = 1;
+    // Side of random field created before run, 0 uses existing file
+    uint64_t create = 0;
+    double density = 0.2;
+};
+
+/**
+ * Parse command line options of headless mode.
+ * Return false if arguments are wrong, options of headless and out of
+ * core runs are wrong without --headless and --out-of-core.
+ * @param argc
+ * @param args
+ * @param options
+ * @return
+ */
+static bool parse_args(int argc, char* args[], HeadlessOptions& options,
+                       OutOfCoreOptions& outOfCore)
+{
+    bool outputSet = false;
+    bool headlessSet = false;
+    bool outOfCoreSet = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = args[i];
+            if (arg == "--headless") {
+                options.enabled = true;
+                continue;
+            }
+
+            if (i + 1 >= argc)
+                return false;
+
+            std::string val = args[++i];
+            headlessSet |= arg == "--frames" || arg == "--size"
+                           || arg == "--format" || arg == "--output"
+                           || arg == "--fps" || arg == "--replay";
+            outOfCoreSet |= arg == "--generations" || arg == "--create"
+                            || arg == "--density";
+            if (arg == "--frames") {
+                options.frames = std::stoull(val);
+            } else if (arg == "--size") {
+                size_t sep = val.find('x');
+                if (sep == std::string::npos)
+                    return false;
+                options.width = std::stoi(val.substr(0, sep));
+                options.height = std::stoi(val.substr(sep + 1));
+            } else if (arg == "--format") {
+                if (val == "png")
+                    options.format = FrameFormat::PNG;
+                else if (val == "y4m")
+                    options.format = FrameFormat::Y4M;
+                else
+                    return false;
+            } else if (arg == "--output") {
+                options.output = val;
+                outputSet = true;
+            } else if (arg == "--fps") {
+                options.fps = std::stoi(val);
+            } else if (arg == "--replay") {
+                options.replay = val;
+            } else if (arg == "--out-of-core") {
+                outOfCore.file = val;
+            } else if (arg == "--generations") {
+                outOfCore.generations = std::stoull(val);
+            } else if (arg == "--create") {
+                outOfCore.create = std::stoull(val);
+            } else if (arg == "--density") {
+                outOfCore.density = std::stod(val);
+            } else {
+                return false;
+            }
+        }
+    } catch (const std::logic_error&) {
+        return false;
+    }
+
+    // Otherwise they would be ignored by windowed game
+    if ((headlessSet && !options.enabled)
+        || (outOfCoreSet && outOfCore.file.empty()))
+        return false;
+
+    if (!outputSet && options.format == FrameFormat::Y4M)
+        options.output = "life.y4m";
+
+    return options.width > 0 && options.height > 0 && options.fps > 0;
+}
+
+/**
+ * Step snapshot file generation by generation, field isn't loaded
+ * to memory, so it may be larger than RAM
+ * @param options
+ * @return
+ */
+static int run_out_of_core(const OutOfCoreOptions& options)
+{
+    using clock = std::chrono::steady_clock;
+
+    try {
+        if (options.create > 0) {
+            Config::load("config.txt");
+            const auto rule_val = [](const char* key, int defaultVal) {
+                return static_cast<uint32_t>(Config::hasKey(key)
+                                             ? Config::getVal<int>(key)
+                                             : defaultVal);
+            };
+            const utils::snapshot::SnapshotInfo info{
+                    rule_val("NeirCount", 3), rule_val("NeirCountDie", 4)};
+            utils::MappedField::create(options.file, options.create,
+                                       options.create, options.create, info,
+                                       options.density, std::random_device()());
+        }
+
+        utils::MappedField field(options.file);
+        ThreadPool pool(get_thread_count());
+        for (size_t i = 0; i < options.generations; ++i) {
+            const auto start = clock::now();
+            field.step(pool);
+            const std::chrono::duration<double> time = clock::now() - start;
+            std::cout << boost::format("generation %d: %d alive, %.2f s\n")
+                         % field.getLayout().generation % field.getAliveCount()
+                         % time.count();
+        }
+    } catch (const BaseGameException& e) {
+        utils::log::Logger::write(e.fileLog(), e.categoryError(), e.what());
+        return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        utils::log::Logger::write(program_log_file_name(),
+                                  Category::UNEXPECTED_ERROR, e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char *args[])
 {
 #ifndef NDEBUG
@@ -21,6 +174,16 @@ int main(int argc, char *args[])
     CALLGRIND_TOGGLE_COLLECT;
 #endif
 
+    HeadlessOptions headless;
+    OutOfCoreOptions outOfCore;
+    if (!parse_args(argc, args, headless, outOfCore)) {
+        std::cerr << usage;
+        return EXIT_FAILURE;
+    }
+    if (!outOfCore.file.empty())
+        return run_out_of_core(outOfCore);
+    setHeadlessOptions(headless);
+
     int ret_code = 0;
     try {
         Config::load("config.txt");
@@ -33,8 +196,7 @@ int main(int argc, char *args[])
         game.initGame();
         auto camera = Camera::getInstance();
 
-        int screen_width = utils::getWindowWidth<int>(*Game::getWindow());
-        int screen_height = utils::getWindowHeight<int>(*Game::getWindow());
+        auto [screen_width, screen_height] = getFrameSize();
         program->useFramebufferProgram();
         glm::mat4 perspective = camera->getProjection(screen_width, screen_height);
         program->setProjection(perspective);
@@ -48,7 +210,16 @@ int main(int argc, char *args[])
         GLfloat delta_time = 0.f;
         GLfloat last_frame = 0.f;
 
+        // Headless run plays the simulation from start
+        if (isHeadless())
+            setGameState(GameStates::PLAY);
+        if (isHeadless() && !headless.replay.empty()) {
+            Config::getVal<std::string>("JournalFile") = headless.replay;
+            requestSimulation(SimulationRequest::REPLAY);
+        }
+
         bool firstRun = true;
+        size_t frames = 0;
         while (isGameRunnable()) {
             GLfloat cur_time = SDL_GetTicks();
             delta_time = cur_time - last_frame;
@@ -58,7 +229,10 @@ int main(int argc, char *args[])
             game.update(delta_time);
             game.flush();
 
-            if (firstRun) {
+            if (isHeadless() && ++frames == headless.frames)
+                setGameRunnable(false);
+
+            if (firstRun && !isHeadless()) {
                 if (SDL_CaptureMouse(SDL_TRUE) != 0)
                     utils::log::Logger::write(program_log_file_name(),
                                               Category::INITIALIZATION_ERROR,
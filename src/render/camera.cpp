@@ -104,8 +104,9 @@ void Camera::updateView()
     int screen_width = utils::getDisplayWidth<int>();
     int screen_height = utils::getDisplayHeight<int>();
 
-    GLfloat deltaAngleX = (2 * M_PI / screen_width);
-    GLfloat deltaAngleY = (M_PI / screen_height);
+    // Without display (headless run) camera isn't rotated by mouse
+    GLfloat deltaAngleX = screen_width > 0 ? 2 * M_PI / screen_width : 0.f;
+    GLfloat deltaAngleY = screen_height > 0 ? M_PI / screen_height : 0.f;
     GLfloat xAngle = m_xOffset * deltaAngleX;
     GLfloat yAngle = m_yOffset * deltaAngleY;
 
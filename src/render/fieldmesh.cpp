@@ -0,0 +1,353 @@
+#include <cstddef>
+#include <algorithm>
+#include <boost/format.hpp>
+
+#include "render/fieldmesh.hpp"
+#include "exceptions/glexception.hpp"
+#include "utils/logger.hpp"
+#include "utils/math.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+using glm::vec2;
+using glm::vec3;
+using utils::math::distance_to_box;
+
+/**
+ * Emit quad origin, origin + du, origin + du + dv, origin + dv.
+ * Front side of quad is the side where du x dv looks.
+ * @param vertices
+ * @param indices
+ * @param origin
+ * @param du
+ * @param dv
+ * @param width size of quad along du in cells
+ * @param height size of quad along dv in cells
+ * @param color
+ * @param flip swap front and back sides
+ */
+static void emit_quad(std::vector<FieldMesh::Vertex>& vertices,
+                      std::vector<GLuint>& indices,
+                      const vec3& origin, const vec3& du, const vec3& dv,
+                      GLfloat width, GLfloat height, uint32_t color, bool flip)
+{
+    auto first = static_cast<GLuint>(vertices.size());
+    vertices.push_back({origin, {0.f, 0.f}, color});
+    vertices.push_back({origin + du, {width, 0.f}, color});
+    vertices.push_back({origin + du + dv, {width, height}, color});
+    vertices.push_back({origin + dv, {0.f, height}, color});
+
+    if (flip)
+        indices.insert(indices.end(), {first, first + 2, first + 1,
+                                       first, first + 3, first + 2});
+    else
+        indices.insert(indices.end(), {first, first + 1, first + 2,
+                                       first, first + 2, first + 3});
+}
+
+/**
+ * Emit box from min to max with faces looking outside
+ * @param vertices
+ * @param indices
+ * @param min
+ * @param max
+ * @param color
+ */
+static void emit_box(std::vector<FieldMesh::Vertex>& vertices,
+                     std::vector<GLuint>& indices,
+                     const vec3& min, const vec3& max, uint32_t color)
+{
+    const vec3 size = max - min;
+    for (size_t axis = 0; axis < 3; ++axis) {
+        vec3 du(0.f), dv(0.f);
+        du[(axis + 1) % 3] = size[(axis + 1) % 3];
+        dv[(axis + 2) % 3] = size[(axis + 2) % 3];
+
+        // Outline is drawn only on the edges of box
+        emit_quad(vertices, indices, min, du, dv, 1.f, 1.f, color, true);
+        vec3 origin = min;
+        origin[axis] = max[axis];
+        emit_quad(vertices, indices, origin, du, dv, 1.f, 1.f, color, false);
+    }
+}
+
+FieldMesh::FieldMesh() : m_version(0), m_colored(false)
+{
+}
+
+FieldMesh::~FieldMesh()
+{
+    free_chunks();
+}
+
+void FieldMesh::free_chunks()
+{
+    for (auto& chunk: m_chunks) {
+        glDeleteBuffers(1, &chunk.vbo);
+        glDeleteBuffers(1, &chunk.ebo);
+        glDeleteVertexArrays(1, &chunk.vao);
+    }
+
+    m_chunks.clear();
+}
+
+void FieldMesh::reset(size_t chunksCount)
+{
+    free_chunks();
+    m_chunks.resize(chunksCount);
+    m_version = 0;
+}
+
+void FieldMesh::build_chunk(const FieldComponent& field, size_t idx,
+                            bool colored, ChunkMesh& mesh)
+{
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.indicesCount = 0;
+    mesh.impostorCount = 0;
+
+    const auto chunk = field.getChunk(idx);
+    const size_t sizes[3] = {field.sizeX, field.sizeY, field.sizeZ};
+    const size_t begin[3] = {chunk.beginX, chunk.beginY, chunk.beginZ};
+    const size_t end[3] = {chunk.endX, chunk.endY, chunk.endZ};
+    const GLfloat half = field.cellSize;
+
+    // Key of exposed face in slice, -1 if there is no face.
+    // Faces with the same key are merged
+    std::vector<int64_t> mask;
+
+    // Bounds and average color of live cells for impostor
+    size_t cellsMin[3] = {end[0], end[1], end[2]};
+    size_t cellsMax[3] = {0, 0, 0};
+    size_t liveCount = 0;
+    glm::vec4 colorSum(0.f);
+    field.forEachCell(chunk, [&](size_t x, size_t y, size_t z, size_t cell) {
+        if (!field.alive[cell])
+            return;
+
+        const size_t coords[3] = {x, y, z};
+        for (size_t i = 0; i < 3; ++i) {
+            cellsMin[i] = std::min(cellsMin[i], coords[i]);
+            cellsMax[i] = std::max(cellsMax[i], coords[i]);
+        }
+        colorSum += unpack_color(field.colors[cell]);
+        ++liveCount;
+    });
+
+    if (liveCount == 0)
+        return;
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+        const size_t uAxis = (axis + 1) % 3;
+        const size_t vAxis = (axis + 2) % 3;
+        const size_t width = end[uAxis] - begin[uAxis];
+        const size_t height = end[vAxis] - begin[vAxis];
+        mask.resize(width * height);
+
+        for (int sign: {-1, 1}) {
+            for (size_t slice = begin[axis]; slice < end[axis]; ++slice) {
+                // Fill mask of faces exposed to sign side
+                for (size_t v = 0; v < height; ++v) {
+                    for (size_t u = 0; u < width; ++u) {
+                        size_t cell[3];
+                        cell[axis] = slice;
+                        cell[uAxis] = begin[uAxis] + u;
+                        cell[vAxis] = begin[vAxis] + v;
+                        size_t cellIdx = field.index(cell[0], cell[1], cell[2]);
+
+                        int64_t& key = mask[v * width + u];
+                        key = -1;
+                        if (!field.alive[cellIdx])
+                            continue;
+
+                        // Unsigned overflow also goes out of bounds
+                        cell[axis] += sign;
+                        if (cell[axis] < sizes[axis]
+                            && field.isAlive(cell[0], cell[1], cell[2]))
+                            continue;
+
+                        key = colored ? field.colors[cellIdx] : 0;
+                    }
+                }
+
+                // Merge faces to maximal rectangles
+                for (size_t v = 0; v < height; ++v) {
+                    for (size_t u = 0; u < width;) {
+                        const int64_t key = mask[v * width + u];
+                        if (key == -1) {
+                            ++u;
+                            continue;
+                        }
+
+                        size_t w = 1;
+                        while (u + w < width && mask[v * width + u + w] == key)
+                            ++w;
+
+                        size_t h = 1;
+                        for (; v + h < height; ++h) {
+                            auto row = mask.begin() + (v + h) * width + u;
+                            if (std::any_of(row, row + w, [key](int64_t k) {
+                                return k != key;
+                            }))
+                                break;
+                        }
+
+                        for (size_t dy = 0; dy < h; ++dy)
+                            std::fill_n(mask.begin() + (v + dy) * width + u, w, -1);
+
+                        vec3 origin, du(0.f), dv(0.f);
+                        origin[axis] = 2.f * half * slice + sign * half;
+                        origin[uAxis] = 2.f * half * (begin[uAxis] + u) - half;
+                        origin[vAxis] = 2.f * half * (begin[vAxis] + v) - half;
+                        du[uAxis] = 2.f * half * w;
+                        dv[vAxis] = 2.f * half * h;
+
+                        emit_quad(mesh.vertices, mesh.indices, origin, du, dv,
+                                  w, h, static_cast<uint32_t>(key), sign < 0);
+                        u += w;
+                    }
+                }
+            }
+        }
+    }
+
+    mesh.indicesCount = mesh.indices.size();
+    for (size_t i = 0; i < 3; ++i) {
+        mesh.boxMin[i] = 2.f * half * cellsMin[i] - half;
+        mesh.boxMax[i] = 2.f * half * cellsMax[i] + half;
+    }
+    emit_box(mesh.vertices, mesh.indices, mesh.boxMin, mesh.boxMax,
+             colored ? pack_color(colorSum / static_cast<GLfloat>(liveCount)) : 0);
+    mesh.impostorCount = mesh.indices.size() - mesh.indicesCount;
+}
+
+void FieldMesh::upload_chunk(ChunkMesh& mesh)
+{
+    if (mesh.indices.empty())
+        return;
+
+    if (mesh.vao == 0) {
+        glGenVertexArrays(1, &mesh.vao);
+        glGenBuffers(1, &mesh.vbo);
+        glGenBuffers(1, &mesh.ebo);
+
+        glBindVertexArray(mesh.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              (void*)offsetof(Vertex, pos));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              (void*)offsetof(Vertex, cellCoords));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                              (void*)offsetof(Vertex, color));
+        glEnableVertexAttribArray(2);
+    } else {
+        glBindVertexArray(mesh.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(Vertex),
+                 mesh.vertices.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint),
+                 mesh.indices.data(), GL_DYNAMIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Cpu copy isn't needed anymore
+    mesh.vertices = {};
+    mesh.indices = {};
+}
+
+void FieldMesh::update(const FieldComponent& field, ThreadPool& pool,
+                       bool colored)
+{
+    if (m_chunks.size() != field.chunksCount())
+        reset(field.chunksCount());
+
+    // Faces are merged by other keys now
+    if (colored != m_colored) {
+        m_colored = colored;
+        m_version = 0;
+    }
+
+    if (field.version == m_version)
+        return;
+
+    // Faces on the chunk border depend on cells of adjacent chunk,
+    // so neighbours of changed chunk are rebuilt too
+    std::vector<uint8_t> dirty(m_chunks.size(), 0);
+    for (size_t i = 0; i < m_chunks.size(); ++i) {
+        if (field.chunkVersions[i] <= m_version)
+            continue;
+
+        auto chunk = field.getChunk(i);
+        size_t cx = chunk.beginX / FieldComponent::chunk_size;
+        size_t cy = chunk.beginY / FieldComponent::chunk_size;
+        size_t cz = chunk.beginZ / FieldComponent::chunk_size;
+        dirty[i] = 1;
+        if (cx > 0)
+            dirty[i - field.chunksY * field.chunksZ] = 1;
+        if (cx + 1 < field.chunksX)
+            dirty[i + field.chunksY * field.chunksZ] = 1;
+        if (cy > 0)
+            dirty[i - field.chunksZ] = 1;
+        if (cy + 1 < field.chunksY)
+            dirty[i + field.chunksZ] = 1;
+        if (cz > 0)
+            dirty[i - 1] = 1;
+        if (cz + 1 < field.chunksZ)
+            dirty[i + 1] = 1;
+    }
+
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+        if (dirty[i])
+            pool.addJob([&field, i, colored, this]() {
+                build_chunk(field, i, colored, m_chunks[i]);
+            });
+    pool.waitForFinish();
+
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+        if (dirty[i])
+            upload_chunk(m_chunks[i]);
+
+    m_version = field.version;
+
+    if (GLenum error = glGetError(); error != GL_NO_ERROR)
+        throw GLException((format("Unable to upload field mesh: %1%\n")
+                           % gluErrorString(error)).str(),
+                          program_log_file_name(), Category::INTERNAL_ERROR);
+}
+
+void FieldMesh::draw(const Frustum& frustum, const vec3& eye,
+                     GLfloat lodDistance) const
+{
+    for (const auto& chunk: m_chunks) {
+        if (chunk.indicesCount == 0
+            || !frustum.intersects(chunk.boxMin, chunk.boxMax))
+            continue;
+
+        glBindVertexArray(chunk.vao);
+        if (distance_to_box(eye, chunk.boxMin, chunk.boxMax) > lodDistance)
+            glDrawElements(GL_TRIANGLES, chunk.impostorCount, GL_UNSIGNED_INT,
+                           (void*)(chunk.indicesCount * sizeof(GLuint)));
+        else
+            glDrawElements(GL_TRIANGLES, chunk.indicesCount, GL_UNSIGNED_INT,
+                           nullptr);
+    }
+
+    glBindVertexArray(0);
+}
+
+size_t FieldMesh::getTrianglesCount() const
+{
+    size_t count = 0;
+    for (const auto& chunk: m_chunks)
+        count += chunk.indicesCount / 3;
+
+    return count;
+}
@@ -0,0 +1,205 @@
+#include <filesystem>
+#include <cstring>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <boost/format.hpp>
+
+#include "render/framerecorder.hpp"
+#include "exceptions/fsexception.hpp"
+#include "exceptions/sdlexception.hpp"
+#include "exceptions/glexception.hpp"
+
+using utils::log::program_log_file_name;
+using utils::log::Category;
+using boost::format;
+
+// Wait for fence by one second steps
+const GLuint64 frame_wait_timeout = 1000000000;
+
+FrameRecorder::FrameRecorder(GLsizei width, GLsizei height,
+                             FrameFormat frameFormat, std::string output,
+                             int fps) :
+        m_width(width), m_height(height), m_format(frameFormat),
+        m_output(std::move(output)), m_fps(fps), m_buffers{}, m_fences{},
+        m_next(0), m_framesCount(0)
+{
+    if (m_format == FrameFormat::PNG) {
+        std::error_code ec;
+        std::filesystem::create_directories(m_output, ec);
+        if (ec)
+            throw FSException((format("Can't create directory %s: %s\n")
+                               % m_output % ec.message()).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+    } else {
+        m_stream.open(m_output, std::ios::binary | std::ios::trunc);
+        if (!m_stream)
+            throw FSException((format("Can't open %s\n") % m_output).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        // 4:4:4 keeps full color resolution of cells outlines
+        m_stream << "YUV4MPEG2 W" << m_width << " H" << m_height
+                 << " F" << m_fps << ":1 Ip A1:1 C444\n";
+    }
+
+    const GLsizeiptr size = static_cast<GLsizeiptr>(m_width) * m_height * 4;
+    glGenBuffers(buffers_count, m_buffers.data());
+    for (GLuint buffer: m_buffers) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    try {
+        finish();
+    } catch (const BaseGameException& e) {
+        utils::log::Logger::write(e.fileLog(), e.categoryError(), e.what());
+    }
+
+    for (auto& fence: m_fences)
+        if (fence)
+            glDeleteSync(fence);
+    glDeleteBuffers(buffers_count, m_buffers.data());
+}
+
+void FrameRecorder::capture(GLuint framebuffer)
+{
+    // All buffers are busy, oldest frame must be written first
+    if (m_pending.size() == buffers_count)
+        write_oldest(true);
+
+    const size_t idx = m_next;
+    m_next = (m_next + 1) % buffers_count;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[idx]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    m_fences[idx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_pending.push_back(idx);
+
+    // Write frames which are already read without waiting
+    while (!m_pending.empty() && write_oldest(false))
+        ;
+}
+
+void FrameRecorder::finish()
+{
+    while (!m_pending.empty())
+        write_oldest(true);
+
+    if (m_stream.is_open())
+        m_stream.flush();
+}
+
+size_t FrameRecorder::getFramesCount() const
+{
+    return m_framesCount;
+}
+
+bool FrameRecorder::write_oldest(bool wait)
+{
+    const size_t idx = m_pending.front();
+    GLsync& fence = m_fences[idx];
+
+    GLenum res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  wait ? frame_wait_timeout : 0);
+    if (!wait && res == GL_TIMEOUT_EXPIRED)
+        return false;
+    while (res == GL_TIMEOUT_EXPIRED)
+        res = glClientWaitSync(fence, 0, frame_wait_timeout);
+
+    glDeleteSync(fence);
+    fence = nullptr;
+    m_pending.pop_front();
+
+    if (res == GL_WAIT_FAILED)
+        throw GLException("Failed to wait frame readback\n",
+                          program_log_file_name(), Category::INTERNAL_ERROR);
+
+    const GLsizeiptr size = static_cast<GLsizeiptr>(m_width) * m_height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[idx]);
+    const auto* pixels = static_cast<const uint8_t*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+    if (!pixels) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        throw GLException("Unable to map frame buffer\n",
+                          program_log_file_name(), Category::INTERNAL_ERROR);
+    }
+
+    if (m_format == FrameFormat::PNG)
+        write_png(pixels);
+    else
+        write_y4m(pixels);
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    ++m_framesCount;
+    return true;
+}
+
+void FrameRecorder::write_png(const uint8_t* pixels)
+{
+    // Gl rows go from bottom to top
+    const size_t pitch = static_cast<size_t>(m_width) * 4;
+    m_frame.resize(pitch * m_height);
+    for (GLsizei y = 0; y < m_height; ++y)
+        std::memcpy(&m_frame[y * pitch], pixels + (m_height - 1 - y) * pitch,
+                    pitch);
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(
+            m_frame.data(), m_width, m_height, 32, pitch,
+            SDL_PIXELFORMAT_RGBA32);
+    if (!surface)
+        throw SdlException((format("Unable to create frame surface. "
+                                   "SDL Error: %s\n") % SDL_GetError()).str(),
+                           program_log_file_name(), Category::INTERNAL_ERROR);
+
+    const std::string file = (format("%s/frame_%06d.png")
+                              % m_output % m_framesCount).str();
+    int res = IMG_SavePNG(surface, file.c_str());
+    SDL_FreeSurface(surface);
+    if (res != 0)
+        throw SdlException((format("Unable to save %s. SDL Error: %s\n")
+                            % file % IMG_GetError()).str(),
+                           program_log_file_name(), Category::FILE_ERROR);
+}
+
+void FrameRecorder::write_y4m(const uint8_t* pixels)
+{
+    // BT.601 studio range, planes go one after another
+    const size_t planeSize = static_cast<size_t>(m_width) * m_height;
+    m_frame.resize(planeSize * 3);
+    uint8_t* yPlane = m_frame.data();
+    uint8_t* uPlane = yPlane + planeSize;
+    uint8_t* vPlane = uPlane + planeSize;
+
+    for (GLsizei y = 0; y < m_height; ++y) {
+        const uint8_t* row = pixels + static_cast<size_t>(m_height - 1 - y)
+                                      * m_width * 4;
+        const size_t out = static_cast<size_t>(y) * m_width;
+        for (GLsizei x = 0; x < m_width; ++x) {
+            const int r = row[4 * x];
+            const int g = row[4 * x + 1];
+            const int b = row[4 * x + 2];
+            yPlane[out + x] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            uPlane[out + x] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            vPlane[out + x] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+
+    m_stream << "FRAME\n";
+    m_stream.write(reinterpret_cast<const char*>(m_frame.data()),
+                   m_frame.size());
+    if (!m_stream)
+        throw FSException((format("Unable to write frame to %s\n")
+                           % m_output).str(),
+                          program_log_file_name(), Category::FILE_ERROR);
+}
@@ -0,0 +1,38 @@
+#include <glm/geometric.hpp>
+
+#include "render/frustum.hpp"
+
+using glm::vec3;
+using glm::vec4;
+
+Frustum::Frustum(const glm::mat4& matrix)
+{
+    // Rows of clip matrix, glm is column major
+    vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = {matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]};
+
+    m_planes[0] = rows[3] + rows[0];
+    m_planes[1] = rows[3] - rows[0];
+    m_planes[2] = rows[3] + rows[1];
+    m_planes[3] = rows[3] - rows[1];
+    m_planes[4] = rows[3] + rows[2];
+    m_planes[5] = rows[3] - rows[2];
+
+    for (auto& plane: m_planes)
+        plane /= glm::length(vec3(plane));
+}
+
+bool Frustum::intersects(const vec3& min, const vec3& max) const
+{
+    for (const auto& plane: m_planes) {
+        // Corner of box which is the farthest along plane normal
+        vec3 corner = {plane.x >= 0.f ? max.x : min.x,
+                       plane.y >= 0.f ? max.y : min.y,
+                       plane.z >= 0.f ? max.z : min.z};
+        if (glm::dot(vec3(plane), corner) + plane.w < 0.f)
+            return false;
+    }
+
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "render/render.hpp"
+#include "render/streambuffer.hpp"
 #include "utils/math.hpp"
 
 using glm::vec2;
@@ -7,56 +8,50 @@ using glm::vec3;
 using utils::math::rotate_around;
 using utils::math::operator/;
 
+namespace
+{
+    /**
+     * Draw 2d points from stream buffer with vao shared by all calls
+     * @param mode
+     * @param points
+     */
+    void draw_points(GLenum mode, const std::vector<vec2>& points)
+    {
+        if (points.empty())
+            return;
+
+        static GLuint VAO = 0;
+        if (VAO == 0)
+            glGenVertexArrays(1, &VAO);
+
+        auto stream = StreamBuffer::getInstance();
+        auto alloc = stream->write(points.data(), sizeof(vec2) * points.size(),
+                                   sizeof(vec2));
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, stream->getBuffer());
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)alloc.offset);
+        glEnableVertexAttribArray(0);
+
+        glDrawArrays(mode, 0, points.size());
+
+        glDisableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+}
+
 void render::drawLinen(const std::vector<vec2>& points, bool adjacency)
 {
     if (adjacency)
         assert(points.size() % 2 == 0);
 
-    auto vertices = points.data();
-
-    GLuint verticesID = 0;
-    GLuint VAO = 0;
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &verticesID);
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, verticesID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vec2) * points.size(), vertices,
-                 GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glEnableVertexAttribArray(0);
-
-    glDrawArrays(adjacency ? GL_LINE_STRIP_ADJACENCY : GL_LINES, 0, points.size());
-
-    glDisableVertexAttribArray(0);
-
-    glDeleteBuffers(1, &verticesID);
-    glDeleteVertexArrays(1, &VAO);
+    draw_points(adjacency ? GL_LINE_STRIP_ADJACENCY : GL_LINES, points);
 }
 
 void render::drawDots(const std::vector<vec2>& dots)
 {
-    auto vertices = dots.data();
-
-    GLuint VAO = 0;
-    GLuint verticesID = 0;
-
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    glGenBuffers(1, &verticesID);
-    glBindBuffer(GL_ARRAY_BUFFER, verticesID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vec2) * dots.size(), vertices,
-                 GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glEnableVertexAttribArray(0);
-    glDrawArrays(GL_POINTS, 0, dots.size());
-    glDisableVertexAttribArray(0);
-
-    glDeleteBuffers(1, &verticesID);
-    glDeleteVertexArrays(1, &VAO);
+    draw_points(GL_POINTS, dots);
 }
 
 void
@@ -84,7 +79,8 @@ render::drawTextureScale(ShaderProgram& program, const Texture &texture,
 
     glBindTexture(GL_TEXTURE_2D, texture.getTextureID());
     glBindVertexArray(texture.getVAO());
-    glDrawArrays(GL_TRIANGLES, 0, 1665);
+    glDrawElements(GL_TRIANGLES, texture.getIndicesCount(), GL_UNSIGNED_INT,
+                   nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindVertexArray(0);
 
@@ -115,7 +111,8 @@ render::drawTextureScale(ShaderProgram& program, const Texture &texture,
 
     glBindTexture(GL_TEXTURE_2D, texture.getTextureID());
     glBindVertexArray(texture.getVAO());
-    glDrawArrays(GL_TRIANGLES, 0, 1665);
+    glDrawElements(GL_TRIANGLES, texture.getIndicesCount(), GL_UNSIGNED_INT,
+                   nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindVertexArray(0);
 
@@ -138,7 +135,8 @@ void render::drawTexture(ShaderProgram& program, const Texture &texture,
 
     glBindTexture(GL_TEXTURE_2D, texture.getTextureID());
     glBindVertexArray(texture.getVAO());
-    glDrawArrays(GL_TRIANGLES, 0, 1665);
+    glDrawElements(GL_TRIANGLES, texture.getIndicesCount(), GL_UNSIGNED_INT,
+                   nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindVertexArray(0);
 
@@ -147,28 +145,46 @@ void render::drawTexture(ShaderProgram& program, const Texture &texture,
     program.updateModel();
 }
 
-void render::drawTriangles(const std::vector<vec2>& points)
+void render::drawTextureInstanced(ShaderProgram& program, const Sprite& sprite,
+                                  GLuint instanceVBO, GLsizei first,
+                                  GLsizei count, GLsizei stride)
 {
-    assert(points.size() % 3 == 0);
-    auto vertices = points.data();
+    assert(sprite.getVAO() != 0);
+    if (count == 0)
+        return;
 
-    GLuint verticesID = 0;
-    GLuint VAO = 0;
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &verticesID);
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, verticesID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vec2) * points.size(), vertices,
-                 GL_STATIC_DRAW);
+    program.updateModel();
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glEnableVertexAttribArray(0);
+    glBindTexture(GL_TEXTURE_2D, sprite.getTextureID());
+    glBindVertexArray(sprite.getVAO());
+
+    // Sprite vao is shared, so instance attributes are
+    // enabled only for this draw
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    auto offset = static_cast<GLintptr>(first) * stride;
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          (void*)(offset + 3 * sizeof(GLfloat)));
+    glVertexAttribDivisor(3, 1);
+    glEnableVertexAttribArray(3);
+
+    glDrawElementsInstanced(GL_TRIANGLES, sprite.getIndicesCount(),
+                            GL_UNSIGNED_INT, nullptr, count);
+
+    glDisableVertexAttribArray(2);
+    glDisableVertexAttribArray(3);
+    glVertexAttribDivisor(2, 0);
+    glVertexAttribDivisor(3, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glDrawArrays(GL_TRIANGLES, 0, points.size());
-    glDisableVertexAttribArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+}
 
-    glDeleteBuffers(1, &verticesID);
-    glDeleteVertexArrays(1, &VAO);
+void render::drawTriangles(const std::vector<vec2>& points)
+{
+    assert(points.size() % 3 == 0);
+    draw_points(GL_TRIANGLES, points);
 }
@@ -25,6 +25,7 @@ ShaderProgram::~ShaderProgram()
 void ShaderProgram::freeProgram()
 {
     glDeleteProgram(m_programID);
+    m_uniformLocations.erase(m_programID);
 }
 
 void ShaderProgram::bind() const
@@ -49,12 +50,44 @@ GLuint ShaderProgram::getProgramID()
     return m_programID;
 }
 
+GLint ShaderProgram::getUniformLocation(const std::string& name)
+{
+    auto& locations = m_uniformLocations[m_programID];
+    if (auto it = locations.find(name); it != locations.end())
+        return it->second;
+
+    GLint loc = glGetUniformLocation(m_programID, name.c_str());
+    locations.emplace(name, loc);
+
+    return loc;
+}
+
+void ShaderProgram::setFloat(GLint loc, GLfloat value)
+{
+    glUniform1f(loc, value);
+}
+
+void ShaderProgram::setInt(GLint loc, GLint value)
+{
+    glUniform1i(loc, value);
+}
+
+void ShaderProgram::setVec3(GLint loc, const glm::vec3& value)
+{
+    glUniform3f(loc, value.x, value.y, value.z);
+}
+
+void ShaderProgram::setVec4(GLint loc, const glm::vec4& value)
+{
+    glUniform4f(loc, value.x, value.y, value.z, value.w);
+}
+
 void ShaderProgram::setInt(const std::string& name, GLint value)
 {
     using utils::log::Logger;
 
     assert(!name.empty());
-    GLint loc = glGetUniformLocation(m_programID, name.c_str());
+    GLint loc = getUniformLocation(name);
     if (loc == -1)
         throw GLException((format("Unable to set uniform variable %1%\n") %
                            name).str(),
@@ -73,7 +106,7 @@ void ShaderProgram::setFloat(const std::string &name, GLfloat value)
     using utils::log::Logger;
 
     assert(!name.empty());
-    GLint loc = glGetUniformLocation(m_programID, name.c_str());
+    GLint loc = getUniformLocation(name);
     if (loc == -1)
         throw GLException(
                 (format("Can't find location by name \"%1%\"\n") % name).str(),
@@ -93,7 +126,7 @@ void ShaderProgram::setVec3(const std::string& name, const glm::vec3& value)
     using utils::log::Logger;
 
     assert(!name.empty());
-    GLint loc = glGetUniformLocation(m_programID, name.c_str());
+    GLint loc = getUniformLocation(name);
     if (loc == -1)
         throw GLException((format("Unable to set uniform variable %1%\n") %
                            name).str(),
@@ -112,7 +145,7 @@ void ShaderProgram::setVec4(const std::string& name, const glm::vec4& value)
     using utils::log::Logger;
 
     assert(!name.empty());
-    GLint loc = glGetUniformLocation(m_programID, name.c_str());
+    GLint loc = getUniformLocation(name);
     if (loc == -1)
         throw GLException((format("Unable to set uniform variable %1%\n") %
                            name).str(),
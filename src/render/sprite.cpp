@@ -21,10 +21,9 @@ void Sprite::addTexture(const std::string& objFile,
 {
     using namespace utils::texture;
 
-    std::string textureFile;
-    m_vertices.emplace_back(loadObj(objFile, textureFile));
+    const Mesh& mesh = m_meshes.emplace_back(loadMesh(objFile));
 
-    GLuint textureId = loadTexture(getResourcePath(textureFile),
+    GLuint textureId = loadTexture(getResourcePath(mesh.textureFile),
                                           nullptr, nullptr);
     m_textureIds.emplace_back(textureId);
 
@@ -45,16 +44,23 @@ void Sprite::generateDataBuffer()
 
         glGenVertexArrays(texCount, m_vao);
         GLuint VBO;
+        GLuint EBO;
 
         for (GLuint i = 0; i < texCount; ++i) {
-
-            GLfloat* vertices = &m_vertices[i][0];
+            const auto& mesh = m_meshes[i];
             glBindVertexArray(m_vao[i]);
             glGenBuffers(1, &VBO);
+            glGenBuffers(1, &EBO);
 
-            size_t vertSize = m_vertices[i].size() * sizeof(GLfloat);
+            size_t vertSize = mesh.vertices.size() * sizeof(GLfloat);
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertSize, vertices, GL_STATIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, vertSize, mesh.vertices.data(),
+                         GL_STATIC_DRAW);
+
+            size_t indicesSize = mesh.indices.size() * sizeof(GLuint);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize,
+                         mesh.indices.data(), GL_STATIC_DRAW);
 
             glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, // Pos of vertices
                                   5 * sizeof(GLfloat), nullptr);
@@ -66,8 +72,11 @@ void Sprite::generateDataBuffer()
 
             glBindVertexArray(0);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+            // Buffers live while vao references them
             glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
         }
 
     } else {
@@ -138,6 +147,11 @@ GLuint Sprite::getSpritesCount() const noexcept
     return m_sizes.size();
 }
 
+GLsizei Sprite::getIndicesCount() const
+{
+    return m_meshes[m_textureId].indices.size();
+}
+
 GLuint Sprite::getTextureID() const
 {
     return m_textureIds[m_textureId];
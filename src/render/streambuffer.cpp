@@ -0,0 +1,177 @@
+#include <cstring>
+#include <boost/format.hpp>
+
+#include "render/streambuffer.hpp"
+#include "exceptions/glexception.hpp"
+
+using utils::log::program_log_file_name;
+using boost::format;
+
+// Section is written during one frame, it fits about hundred
+// thousands of 2d vertices
+const GLsizeiptr stream_section_size = 4 * 1024 * 1024;
+// Wait for fence by one second steps
+const GLuint64 fence_wait_timeout = 1000000000;
+
+std::shared_ptr<StreamBuffer> StreamBuffer::instance = nullptr;
+
+StreamBuffer::StreamBuffer(GLsizeiptr sectionSize) :
+        m_buffer(0), m_sectionSize(sectionSize), m_section(0), m_offset(0),
+        m_persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage),
+        m_mapped(nullptr),
+        m_fences{}
+{
+    const GLsizeiptr size = m_sectionSize * sections_count;
+
+    glGenBuffers(1, &m_buffer);
+    // Copy write target doesn't disturb vertex and uniform bindings
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+
+    if (m_persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+                                 | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        m_mapped = static_cast<uint8_t*>(
+                glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+
+        if (!m_mapped) {
+            // Storage is immutable, so fallback needs new buffer
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &m_buffer);
+            glGenBuffers(1, &m_buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+            m_persistent = false;
+        }
+    }
+
+    if (!m_persistent) {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        m_staging.resize(size);
+        m_mapped = m_staging.data();
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (auto& fence: m_fences)
+        if (fence)
+            glDeleteSync(fence);
+
+    if (m_persistent) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    glDeleteBuffers(1, &m_buffer);
+}
+
+std::shared_ptr<StreamBuffer> StreamBuffer::getInstance()
+{
+    if (!instance)
+        instance = std::make_shared<StreamBuffer>(stream_section_size);
+
+    return instance;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size,
+                                                GLsizeiptr alignment)
+{
+    if (size > m_sectionSize)
+        throw GLException((format("Stream allocation of %d bytes is bigger "
+                                  "than section of %d bytes\n")
+                           % size % m_sectionSize).str(),
+                          program_log_file_name(),
+                          Category::INTERNAL_ERROR);
+
+    GLintptr offset = (m_offset + alignment - 1) / alignment * alignment;
+    if (offset + size > m_sectionSize) {
+        next_section();
+        offset = 0;
+    }
+    m_offset = offset + size;
+
+    offset += static_cast<GLintptr>(m_section) * m_sectionSize;
+    return {m_mapped + offset, offset, size};
+}
+
+void StreamBuffer::commit(const Allocation& alloc)
+{
+    // Coherent mapping makes writes visible without any call
+    if (m_persistent)
+        return;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, alloc.offset, alloc.size, alloc.data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::Allocation StreamBuffer::write(const void* data, GLsizeiptr size,
+                                             GLsizeiptr alignment)
+{
+    auto alloc = allocate(size, alignment);
+    std::memcpy(alloc.data, data, size);
+    commit(alloc);
+
+    return alloc;
+}
+
+void StreamBuffer::nextFrame()
+{
+    // Nothing was written, section is still free
+    if (m_offset == 0)
+        return;
+
+    next_section();
+}
+
+GLuint StreamBuffer::getBuffer() const
+{
+    return m_buffer;
+}
+
+bool StreamBuffer::isPersistent() const
+{
+    return m_persistent;
+}
+
+void StreamBuffer::next_section()
+{
+    if (m_persistent)
+        m_fences[m_section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_section = (m_section + 1) % sections_count;
+    m_offset = 0;
+
+    if (m_persistent) {
+        wait_section(m_section);
+    } else if (m_section == 0) {
+        // Orphan storage, draws in flight keep the old one
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_sectionSize * sections_count,
+                     nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+void StreamBuffer::wait_section(size_t section)
+{
+    GLsync& fence = m_fences[section];
+    if (!fence)
+        return;
+
+    GLenum res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  fence_wait_timeout);
+    while (res == GL_TIMEOUT_EXPIRED)
+        res = glClientWaitSync(fence, 0, fence_wait_timeout);
+
+    glDeleteSync(fence);
+    fence = nullptr;
+
+    if (res == GL_WAIT_FAILED)
+        throw GLException("Failed to wait stream buffer fence\n",
+                          program_log_file_name(),
+                          Category::INTERNAL_ERROR);
+}
@@ -181,6 +181,12 @@ GLuint TextTexture::getVAO() const
     return m_vaoId;
 }
 
+GLsizei TextTexture::getIndicesCount() const
+{
+    // Two triangles of quad
+    return 6;
+}
+
 void TextTexture::freeFont() noexcept
 {
     if (m_font)
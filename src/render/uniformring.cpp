@@ -0,0 +1,14 @@
+#include "render/uniformring.hpp"
+
+UniformRing::UniformRing(std::shared_ptr<StreamBuffer> stream) :
+        m_stream(std::move(stream)), m_alignment(256)
+{
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_alignment);
+}
+
+void UniformRing::bind(GLuint binding, const void* data, GLsizeiptr size)
+{
+    auto alloc = m_stream->write(data, size, m_alignment);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_stream->getBuffer(),
+                      alloc.offset, size);
+}
@@ -1,5 +1,10 @@
 #include "systems/animationsystem.hpp"
 
+AnimationSystem::AnimationSystem()
+{
+    writes<SpriteComponent>();
+}
+
 void AnimationSystem::update_state(size_t delta)
 {
 //    auto entities = getEntities();
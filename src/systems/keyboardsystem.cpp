@@ -42,6 +42,7 @@ void KeyboardSystem::update_state(size_t delta)
                     program->setProjection(camera->getProjection(screen_width,
                                                                  screen_height));
                     program->updateProjection();
+                    markSceneDirty();
                 }
                 break;
             case SDL_WINDOWEVENT:
@@ -50,6 +51,7 @@ void KeyboardSystem::update_state(size_t delta)
                     program->setProjection(camera->getProjection(screen_width,
                                                                  screen_height));
                     program->updateProjection();
+                    markSceneDirty();
                 }
                 break;
             default:
@@ -60,11 +62,14 @@ void KeyboardSystem::update_state(size_t delta)
             camera->processMovement(x_offset, y_offset);
             program->setView(camera->getView());
             program->updateView();
+            markSceneDirty();
         }
     }
 }
 
 KeyboardSystem::KeyboardSystem() : m_middlePressed(false)
 {
+    // SDL events and camera
+    runOnMainThread();
 
 }
@@ -3,6 +3,11 @@
 #include "systems/particlerendersystem.hpp"
 #include "render/render.hpp"
 
+ParticleRenderSystem::ParticleRenderSystem()
+{
+    runOnMainThread();
+}
+
 void ParticleRenderSystem::update_state(size_t delta)
 {
 
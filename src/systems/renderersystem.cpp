@@ -8,8 +8,9 @@
 
 #include "systems/renderersystem.hpp"
 #include "components/spritecomponent.hpp"
-#include "components/cellcomponent.hpp"
+#include "components/fieldcomponent.hpp"
 #include "render/render.hpp"
+#include "render/frustum.hpp"
 #include "utils/logger.hpp"
 #include "exceptions/glexception.hpp"
 #include "lifeprogram.hpp"
@@ -25,6 +26,7 @@ using glm::mat4;
 using glm::vec3;
 using glm::scale;
 using utils::math::operator/;
+using utils::math::distance_to_box;
 
 static GLuint genTexture(GLuint width, GLuint height,
                          bool msaa = false, size_t samples = 4)
@@ -82,32 +84,28 @@ throw GLException((boost::format( \
         utils::log::program_log_file_name(), \
         utils::log::Category::INITIALIZATION_ERROR); \
 
-RendererSystem::RendererSystem() : m_frameBuffer(0), m_videoSettingsOpen(false),
+RendererSystem::RendererSystem() : m_fieldVersion(0), m_drawnVersion(0),
+                                   m_drawnSettings{}, m_instanceVBO(0),
+                                   m_instancesCount(0), m_frameBuffer(0),
+                                   m_videoSettingsOpen(false),
                                    m_colorSettingsOpen(false),
                                    m_isMsaa(Config::getVal<bool>("MSAA"))
 {
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
-    io.WantCaptureMouse = true;
-    io.WantCaptureKeyboard = true;
-
-    ImGuiStyle& style = ImGui::GetStyle();
-    style.WindowRounding = 8.f;
-    style.Alpha = 1.0f;
-    style.AntiAliasedLines = false;
+    reads<SpriteComponent, FieldComponent>();
+    runOnMainThread();
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplSDL2_InitForOpenGL(Game::getWindow(), Game::getGLContext());
-    ImGui_ImplOpenGL3_Init();
-
-    int screen_width = utils::getWindowWidth<GLuint>(*Game::getWindow());
-    int screen_height = utils::getWindowHeight<GLuint>(*Game::getWindow());
+    auto [screen_width, screen_height] = getFrameSize();
     m_aspectRatio = static_cast<GLfloat>(screen_width) / screen_height;
 
+    if (isHeadless()) {
+        const auto& options = getHeadlessOptions();
+        m_recorder = std::make_unique<FrameRecorder>(
+                screen_width, screen_height, options.format, options.output,
+                options.fps);
+    } else {
+        init_gui();
+    }
+
     bool msaa = Config::getVal<bool>("MSAA");
 
     if (msaa) {
@@ -147,6 +145,8 @@ RendererSystem::RendererSystem() : m_frameBuffer(0), m_videoSettingsOpen(false),
 
     CHECK_FRAMEBUFFER_COMPLETE();
 
+    glGenBuffers(1, &m_instanceVBO);
+
     auto camera = Camera::getInstance();
     GLfloat cubSize = 20.f;
     int fieldSize = Config::getVal<int>("FieldSize") * (cubSize + 10);
@@ -154,45 +154,190 @@ RendererSystem::RendererSystem() : m_frameBuffer(0), m_videoSettingsOpen(false),
     camera->updateView();
 }
 
+void RendererSystem::init_gui()
+{
+    // Setup Dear ImGui context
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO(); (void)io;
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+    io.WantCaptureMouse = true;
+    io.WantCaptureKeyboard = true;
+
+    ImGuiStyle& style = ImGui::GetStyle();
+    style.WindowRounding = 8.f;
+    style.Alpha = 1.0f;
+    style.AntiAliasedLines = false;
+
+    // Setup Platform/Renderer backends
+    ImGui_ImplSDL2_InitForOpenGL(Game::getWindow(), Game::getGLContext());
+    ImGui_ImplOpenGL3_Init();
+}
+
 RendererSystem::~RendererSystem()
 {
     glDeleteFramebuffers(1, &m_frameBuffer);
+    glDeleteBuffers(1, &m_instanceVBO);
+}
+
+void RendererSystem::updateField()
+{
+    const auto& entities = m_ecsManager->getEntities();
+    for (size_t name: getChangedEntities<FieldComponent>()) {
+        auto it = entities.find(name);
+        if (it == entities.end())
+            continue;
+
+        auto [field, sprite] =
+                it->second->getComponentsPtr<FieldComponent, SpriteComponent>();
+        if (!field || !sprite)
+            continue;
+
+        if (field != m_field.get() || m_chunkCells.size() != field->chunksCount()) {
+            // New field, rebuild everything
+            m_field = it->second->getComponent<FieldComponent>();
+            m_fieldVersion = 0;
+            m_chunkCells.assign(field->chunksCount(), {});
+            m_chunkImpostors.assign(field->chunksCount(), {});
+            m_fieldMesh.reset(field->chunksCount());
+            markSceneDirty();
+        }
+        m_cellSprite = sprite->sprite;
+    }
+}
+
+bool RendererSystem::needRedraw()
+{
+    SceneSettings settings{Config::getVal<glm::vec4>("BackgroundColor"),
+                           Config::getVal<glm::vec4>("CellColor"),
+                           Config::getVal<glm::vec4>("CellBorderColor"),
+                           Config::getVal<bool>("ColoredLife"),
+                           Config::getVal<bool>("SurfaceMesh"),
+                           Config::getVal<GLfloat>("LodDistance"),
+                           getFrameSize().x, getFrameSize().y};
+
+    bool dirty = isSceneDirty() || !(settings == m_drawnSettings)
+                 || (m_field && m_field->version != m_drawnVersion);
+
+    m_drawnSettings = settings;
+    if (m_field)
+        m_drawnVersion = m_field->version;
+
+    return dirty;
+}
+
+void RendererSystem::updateLiveCells()
+{
+    static_assert(sizeof(LiveCell) == 16,
+                  "Instance data of live cell must be tightly packed");
+
+    if (m_field->version == m_fieldVersion)
+        return;
+
+    for (size_t i = 0; i < m_field->chunksCount(); ++i) {
+        if (m_field->chunkVersions[i] <= m_fieldVersion)
+            continue;
+
+        auto& cells = m_chunkCells[i];
+        cells.clear();
+        glm::vec4 colorSum(0.f);
+        m_field->forEachCell(m_field->getChunk(i),
+                             [this, &cells, &colorSum](size_t x, size_t y,
+                                                       size_t z, size_t idx) {
+            if (m_field->alive[idx]) {
+                cells.push_back({2.f * m_field->position(x, y, z),
+                                 m_field->colors[idx]});
+                colorSum += unpack_color(m_field->colors[idx]);
+            }
+        });
+
+        if (cells.empty())
+            continue;
+
+        auto& impostor = m_chunkImpostors[i];
+        impostor.boxMin = impostor.boxMax = cells.front().offset;
+        for (const auto& cell: cells) {
+            impostor.boxMin = glm::min(impostor.boxMin, cell.offset);
+            impostor.boxMax = glm::max(impostor.boxMax, cell.offset);
+        }
+        impostor.boxMin -= vec3(m_field->cellSize);
+        impostor.boxMax += vec3(m_field->cellSize);
+        impostor.instance.offset = 0.5f * (impostor.boxMin + impostor.boxMax);
+        impostor.instance.color = pack_color(
+                colorSum * (1.f / static_cast<GLfloat>(cells.size())));
+    }
+
+    m_fieldVersion = m_field->version;
+
+    size_t count = 0;
+    m_chunkFirst.resize(m_chunkCells.size());
+    for (size_t i = 0; i < m_chunkCells.size(); ++i) {
+        m_chunkFirst[i] = count;
+        count += m_chunkCells[i].size();
+    }
+
+    // Orphan old storage and fill new one chunk by chunk
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER,
+                 (count + m_chunkImpostors.size()) * sizeof(LiveCell),
+                 nullptr, GL_DYNAMIC_DRAW);
+    GLintptr offset = 0;
+    for (const auto& cells: m_chunkCells) {
+        if (cells.empty())
+            continue;
+
+        GLsizeiptr size = cells.size() * sizeof(LiveCell);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, cells.data());
+        offset += size;
+    }
+    std::vector<LiveCell> impostors;
+    impostors.reserve(m_chunkImpostors.size());
+    for (const auto& impostor: m_chunkImpostors)
+        impostors.push_back(impostor.instance);
+    glBufferSubData(GL_ARRAY_BUFFER, offset,
+                    impostors.size() * sizeof(LiveCell), impostors.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_instancesCount = count;
 }
 
 void RendererSystem::drawSprites()
 {
-    const auto& sprites = m_ecsManager->getEntities();
+    if (!m_field || !m_cellSprite)
+        return;
+
     auto program = LifeProgram::getInstance();
     const glm::vec4 borderColor = Config::getVal<glm::vec4>("CellBorderColor");
     const glm::vec4 cellColor = Config::getVal<glm::vec4>("CellColor");
     bool coloredGame = Config::getVal<bool>("ColoredLife");
 
-    if (!coloredGame)
-        program->setVec4("Color", cellColor);
-
-    program->setVec4("OutlineColor", borderColor);
-
-    const auto& sprite = sprites.cbegin()->second->getComponent<SpriteComponent>()
-            ->sprite;
-    GLfloat cellSize = sprite->getWidth();
-    const glm::vec3 scale{cellSize, cellSize, cellSize};
-    mat4 scaling = glm::scale(mat4(1.f), scale);
-    program->leftMultModel(scaling);
-    for (const auto& [key, en]: sprites) {
-        std::shared_ptr<CellComponent> cell;
-        if ((cell = en->getComponent<CellComponent>()))
-            if (!cell->alive)
-                continue;
-
-        if (coloredGame)
-            program->setVec4("Color", cell->color);
-
-        auto posComp = en->getComponent<PositionComponent>();
-        render::drawTexture(*program, *sprite, {posComp->x, posComp->y, posComp->z});
+    // Draw only exposed faces of cells or whole cubes
+    bool surface = Config::getVal<bool>("SurfaceMesh");
+    if (surface) {
+        m_fieldMesh.update(*m_field, m_ecsManager->getThreadPool(),
+                           coloredGame);
+        program->useSurfaceProgram();
+    } else {
+        updateLiveCells();
     }
 
-    scaling = glm::scale(mat4(1.f), 1 / scale);
-    program->leftMultModel(scaling);
+    program->setVec4(program->getUniformLocation("Color"), cellColor);
+    program->setInt(program->getUniformLocation("ColoredLife"), coloredGame);
+    program->setVec4(program->getUniformLocation("OutlineColor"), borderColor);
+
+    // Field is drawn in model space
+    Frustum frustum(program->getProjection() * program->getView()
+                    * program->getModel());
+    if (surface) {
+        program->updateModel();
+        m_fieldMesh.draw(frustum, Camera::getInstance()->getPos(),
+                         Config::getVal<GLfloat>("LodDistance"));
+        program->useFramebufferProgram();
+    } else {
+        drawCells(frustum, Camera::getInstance()->getPos(),
+                  Config::getVal<GLfloat>("LodDistance"));
+    }
 
     if (GLenum error = glGetError(); error != GL_NO_ERROR)
         throw GLException((format("\n\tRender while drawing sprites: %1%\n")
@@ -200,10 +345,72 @@ void RendererSystem::drawSprites()
                           program_log_file_name(), Category::INTERNAL_ERROR);
 }
 
+void RendererSystem::drawCells(const Frustum& frustum, const vec3& eye,
+                               GLfloat lodDistance)
+{
+    auto program = LifeProgram::getInstance();
+    const auto& sprite = m_cellSprite;
+    GLfloat cellSize = sprite->getWidth();
+    const mat4 model = program->getModel();
+    const mat4 cellModel = scale(mat4(1.f), vec3(cellSize)) * model;
+    program->setModel(cellModel);
+
+    // Consecutive visible chunks are drawn with one call
+    GLsizei first = 0;
+    GLsizei count = 0;
+    for (size_t i = 0; i < m_chunkCells.size(); ++i) {
+        if (m_chunkCells[i].empty())
+            continue;
+
+        const auto& impostor = m_chunkImpostors[i];
+        if (!frustum.intersects(impostor.boxMin, impostor.boxMax)) {
+            render::drawTextureInstanced(*program, *sprite, m_instanceVBO,
+                                         first, count, sizeof(LiveCell));
+            count = 0;
+            continue;
+        }
+
+        if (distance_to_box(eye, impostor.boxMin, impostor.boxMax)
+            <= lodDistance) {
+            if (count == 0)
+                first = m_chunkFirst[i];
+            count += m_chunkCells[i].size();
+            continue;
+        }
+
+        render::drawTextureInstanced(*program, *sprite, m_instanceVBO,
+                                     first, count, sizeof(LiveCell));
+        count = 0;
+
+        // Cube sprite stretched over the box, offset isn't scaled by model
+        const vec3 halfSize = 0.5f * (impostor.boxMax - impostor.boxMin);
+        program->setModel(scale(mat4(1.f), halfSize) * model);
+        render::drawTextureInstanced(*program, *sprite, m_instanceVBO,
+                                     m_instancesCount + i, 1,
+                                     sizeof(LiveCell));
+        program->setModel(cellModel);
+    }
+    render::drawTextureInstanced(*program, *sprite, m_instanceVBO,
+                                 first, count, sizeof(LiveCell));
+
+    program->setModel(model);
+    program->updateModel();
+}
+
 void RendererSystem::update_state(size_t delta)
 {
-    drawToFramebuffer();
-    drawGui();
+    updateField();
+    // Previous frame is still in framebuffer texture
+    if (needRedraw()) {
+        drawToFramebuffer();
+        clearSceneDirty();
+    }
+
+    // Unchanged scene is recorded again, so each step has its frame
+    if (m_recorder)
+        m_recorder->capture(m_frameBuffer);
+    else
+        drawGui();
 }
 
 void RendererSystem::drawToFramebuffer()
@@ -211,8 +418,7 @@ void RendererSystem::drawToFramebuffer()
     auto program = LifeProgram::getInstance();
     program->useFramebufferProgram();
 
-    int screen_width = utils::getDisplayWidth<int>();
-    int screen_height = utils::getDisplayHeight<int>();
+    auto [screen_width, screen_height] = getFrameSize();
 
     auto camera = Camera::getInstance();
     glViewport(0.f, 0.f, screen_width, screen_height);
@@ -232,6 +438,15 @@ void RendererSystem::drawToFramebuffer()
     glEnable(GL_DEPTH_TEST);
 
     drawSprites();
+
+    if (m_isMsaa) {
+        // Resolve to texture which is shown by gui or recorded
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frameBufferMSAA);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_frameBuffer);
+        glBlitFramebuffer(0, 0, screen_width, screen_height,
+                          0, 0, screen_width, screen_height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
 }
 
 void RendererSystem::drawGui()
@@ -240,14 +455,6 @@ void RendererSystem::drawGui()
     auto screen_height = utils::getWindowHeight<GLfloat>(*Game::getWindow());
 
     auto program = LifeProgram::getInstance();
-    if (m_isMsaa) {
-        // Render texture to window
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frameBufferMSAA);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_frameBuffer);
-        glBlitFramebuffer(0, 0, screen_width, screen_height, 0, 0,
-                          screen_width, screen_height,
-                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
-    }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -309,6 +516,11 @@ void RendererSystem::drawGui()
             ImGui::SameLine();
             ImGui::InputFloat("##step_time", &Config::getVal<GLfloat>("StepTime"));
 
+            ImGui::Text("Checkpoint every N generations");
+            ImGui::SameLine();
+            ImGui::InputInt("##checkpoint_interval",
+                            &Config::getVal<int>("CheckpointInterval"));
+
             ImGui::Checkbox("Inverse rotation", &Config::getVal<bool>("InverseRotation"));
 
             if (ImGui::Button("Start simulation"))
@@ -327,10 +539,32 @@ void RendererSystem::drawGui()
                 Config::load(Config::getVal<const char*>("ConfigFile"));
 
             if (ImGui::Button("Save simulation"))
-                ;
+                requestSimulation(SimulationRequest::SAVE);
 
             if (ImGui::Button("Load simulation"))
-                ;
+                requestSimulation(SimulationRequest::LOAD);
+
+            ImGui::Checkbox("Record journal(Need simulation restart)",
+                            &Config::getVal<bool>("RecordJournal"));
+
+            if (ImGui::Button("Replay journal"))
+                requestSimulation(SimulationRequest::REPLAY);
+
+            const HistoryRange& history = getHistoryRange();
+            if (history.first < history.last) {
+                ImGui::Text("History");
+                if (ImGui::Button("<") && history.current > history.first)
+                    requestHistorySeek(history.current - 1);
+                ImGui::SameLine();
+                uint64_t generation = history.current;
+                if (ImGui::SliderScalar("##history", ImGuiDataType_U64,
+                                        &generation, &history.first,
+                                        &history.last))
+                    requestHistorySeek(generation);
+                ImGui::SameLine();
+                if (ImGui::Button(">") && history.current < history.last)
+                    requestHistorySeek(history.current + 1);
+            }
 
             if (ImGui::Button("Color Settings"))
                 m_colorSettingsOpen = true;
@@ -370,6 +604,12 @@ void RendererSystem::drawGui()
                     ImGui::InputInt("##msaa_samples",
                                     &Config::getVal<int>("MSAASamples"));
                 }
+                ImGui::Checkbox("Draw only cells surface",
+                                &Config::getVal<bool>("SurfaceMesh"));
+                ImGui::Text("Distance of simplified chunks");
+                ImGui::SameLine();
+                ImGui::InputFloat("##lod_distance",
+                                  &Config::getVal<GLfloat>("LodDistance"));
                 ImGui::Text("Application theme:");
                 ImGui::SameLine();
                 ImGui::ListBox("", &Config::getVal<int>("Theme"), items, 3);
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <boost/format.hpp>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "utils/asyncwriter.hpp"
+#include "utils/logger.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace
+{
+    // Alignment of buffers, offsets and sizes for O_DIRECT
+    const size_t block_size = 4096;
+
+    [[noreturn]] void throw_error(const std::string& file, const char* action,
+                                  int error)
+    {
+        throw FSException((format("Can't %s %s: %s\n")
+                           % action % file % std::strerror(error)).str(),
+                          program_log_file_name(), Category::FILE_ERROR);
+    }
+
+    bool is_zero(const uint8_t* data, size_t size)
+    {
+        return size == 0
+               || (data[0] == 0 && std::memcmp(data, data + 1, size - 1) == 0);
+    }
+
+    unsigned load_acquire(const unsigned* ptr)
+    {
+        return std::atomic_ref<const unsigned>(*ptr).load(
+                std::memory_order_acquire);
+    }
+
+    void store_release(unsigned* ptr, unsigned val)
+    {
+        std::atomic_ref<unsigned>(*ptr).store(val, std::memory_order_release);
+    }
+}
+
+namespace utils
+{
+    /**
+     * io_uring set up by raw syscalls, one write per buffer in flight
+     */
+    struct AsyncFileWriter::Ring
+    {
+        int fd = -1;
+        void* sqRing = MAP_FAILED;
+        size_t sqRingSize = 0;
+        void* cqRing = MAP_FAILED;
+        size_t cqRingSize = 0;
+        void* sqes = MAP_FAILED;
+        size_t sqesSize = 0;
+
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        // Writev is used as it is supported by the oldest io_uring
+        std::vector<iovec> iovecs;
+
+        /**
+         * @param entries
+         * @return nullptr if io_uring isn't available
+         */
+        static std::unique_ptr<Ring> create(unsigned entries)
+        {
+            io_uring_params params{};
+            auto ring = std::make_unique<Ring>();
+            ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, entries,
+                                                &params));
+            if (ring->fd < 0)
+                return nullptr;
+
+            ring->sqRingSize = params.sq_off.array
+                               + params.sq_entries * sizeof(unsigned);
+            ring->cqRingSize = params.cq_off.cqes
+                               + params.cq_entries * sizeof(io_uring_cqe);
+            ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            ring->sqRing = mmap(nullptr, ring->sqRingSize,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring->fd,
+                                IORING_OFF_SQ_RING);
+            ring->cqRing = mmap(nullptr, ring->cqRingSize,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring->fd,
+                                IORING_OFF_CQ_RING);
+            ring->sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring->fd,
+                              IORING_OFF_SQES);
+            if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED
+                || ring->sqes == MAP_FAILED)
+                return nullptr;
+
+            auto* sq = static_cast<uint8_t*>(ring->sqRing);
+            auto* cq = static_cast<uint8_t*>(ring->cqRing);
+            ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            ring->sqMask = reinterpret_cast<unsigned*>(
+                    sq + params.sq_off.ring_mask);
+            ring->sqArray = reinterpret_cast<unsigned*>(
+                    sq + params.sq_off.array);
+            ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            ring->cqMask = reinterpret_cast<unsigned*>(
+                    cq + params.cq_off.ring_mask);
+            ring->cqes = reinterpret_cast<io_uring_cqe*>(
+                    cq + params.cq_off.cqes);
+            ring->iovecs.resize(entries);
+
+            return ring;
+        }
+
+        ~Ring()
+        {
+            if (sqes != MAP_FAILED)
+                munmap(sqes, sqesSize);
+            if (cqRing != MAP_FAILED)
+                munmap(cqRing, cqRingSize);
+            if (sqRing != MAP_FAILED)
+                munmap(sqRing, sqRingSize);
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        /**
+         * Submit write, user data is index of buffer
+         * @return 0 or errno
+         */
+        int push(int file, size_t idx, const uint8_t* data, size_t size,
+                 uint64_t offset)
+        {
+            iovecs[idx] = {const_cast<uint8_t*>(data), size};
+
+            // Only this thread submits, so tail is read without barrier
+            const unsigned tail = *sqTail;
+            const unsigned slot = tail & *sqMask;
+            auto& sqe = static_cast<io_uring_sqe*>(sqes)[slot];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_WRITEV;
+            sqe.fd = file;
+            sqe.addr = reinterpret_cast<uint64_t>(&iovecs[idx]);
+            sqe.len = 1;
+            sqe.off = offset;
+            sqe.user_data = idx;
+            sqArray[slot] = slot;
+            store_release(sqTail, tail + 1);
+
+            return enter(1, 0, 0);
+        }
+
+        /**
+         * Wait for completion
+         * @param idx user data of completed write
+         * @param res bytes written or -errno
+         * @return 0 or errno of waiting
+         */
+        int pop(size_t& idx, int& res)
+        {
+            unsigned head = *cqHead;
+            while (head == load_acquire(cqTail))
+                if (int error = enter(0, 1, IORING_ENTER_GETEVENTS))
+                    return error;
+
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            idx = cqe.user_data;
+            res = cqe.res;
+            store_release(cqHead, head + 1);
+
+            return 0;
+        }
+
+        int enter(unsigned submit, unsigned wait, unsigned flags) const
+        {
+            while (syscall(__NR_io_uring_enter, fd, submit, wait, flags,
+                           nullptr, 0) < 0) {
+                if (errno != EINTR)
+                    return errno;
+            }
+
+            return 0;
+        }
+    };
+
+    AsyncFileWriter::AsyncFileWriter(const std::string& file, bool direct,
+                                     size_t bufferSize, size_t buffersCount) :
+            m_file(file), m_fd(-1), m_direct(false),
+            m_bufferSize(std::max(block_size, bufferSize / block_size
+                                              * block_size)),
+            m_current(0), m_offset(0), m_inFlight(0)
+    {
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        // File systems like tmpfs refuse O_DIRECT
+        if (direct) {
+            m_fd = open(file.c_str(), flags | O_DIRECT, 0644);
+            m_direct = m_fd >= 0;
+        }
+        if (m_fd < 0)
+            m_fd = open(file.c_str(), flags, 0644);
+        if (m_fd < 0)
+            throw_error(file, "open", errno);
+
+        for (size_t i = 0; i < std::max<size_t>(buffersCount, 1); ++i) {
+            auto* data = static_cast<uint8_t*>(
+                    std::aligned_alloc(block_size, m_bufferSize));
+            if (!data) {
+                close_file();
+                throw_error(file, "allocate buffers for", ENOMEM);
+            }
+            m_buffers.push_back({data, 0, 0, false});
+        }
+
+        m_ring = Ring::create(m_buffers.size());
+    }
+
+    AsyncFileWriter::~AsyncFileWriter()
+    {
+        try {
+            while (m_inFlight > 0)
+                complete();
+        } catch (const FSException&) {
+            // Broken file is removed by owner
+        }
+
+        close_file();
+        for (auto& buffer: m_buffers)
+            std::free(buffer.data);
+    }
+
+    std::pair<uint8_t*, size_t> AsyncFileWriter::acquire()
+    {
+        Buffer* buffer = &m_buffers[m_current];
+        if (buffer->used == m_bufferSize && is_zero(buffer->data,
+                                                    buffer->used)) {
+            // Zero buffer is skipped, it becomes a hole of sparse file
+            m_offset += buffer->used;
+            buffer->used = 0;
+        } else if (buffer->used == m_bufferSize) {
+            submit(*buffer);
+            m_current = (m_current + 1) % m_buffers.size();
+            buffer = &m_buffers[m_current];
+            while (buffer->busy)
+                complete();
+            buffer->used = 0;
+        }
+
+        return {buffer->data + buffer->used, m_bufferSize - buffer->used};
+    }
+
+    void AsyncFileWriter::commit(size_t size)
+    {
+        m_buffers[m_current].used += size;
+    }
+
+    void AsyncFileWriter::write(const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            auto [ptr, space] = acquire();
+            const size_t n = std::min(size, space);
+            std::memcpy(ptr, bytes, n);
+            commit(n);
+            bytes += n;
+            size -= n;
+        }
+    }
+
+    void AsyncFileWriter::pad(size_t alignment)
+    {
+        size_t count = (alignment - size() % alignment) % alignment;
+        while (count > 0) {
+            auto [ptr, space] = acquire();
+            const size_t n = std::min(count, space);
+            std::memset(ptr, 0, n);
+            commit(n);
+            count -= n;
+        }
+    }
+
+    void AsyncFileWriter::finish()
+    {
+        Buffer& buffer = m_buffers[m_current];
+        const uint64_t fileSize = size();
+        // Direct write of the last block is padded, the file is cut later
+        if (m_direct) {
+            const size_t padded = (buffer.used + block_size - 1)
+                                  / block_size * block_size;
+            std::memset(buffer.data + buffer.used, 0, padded - buffer.used);
+            buffer.used = padded;
+        }
+        if (!is_zero(buffer.data, buffer.used))
+            submit(buffer);
+
+        while (m_inFlight > 0)
+            complete();
+
+        // Cuts padding of direct write and extends file over trailing hole
+        if (ftruncate(m_fd, fileSize) == -1)
+            throw_error(m_file, "truncate", errno);
+        // File must be on disk before it is renamed over previous one
+        if (fdatasync(m_fd) == -1)
+            throw_error(m_file, "sync", errno);
+
+        // Close reports errors of delayed writes on some file systems
+        const int fd = std::exchange(m_fd, -1);
+        if (close(fd) == -1)
+            throw_error(m_file, "close", errno);
+    }
+
+    uint64_t AsyncFileWriter::size() const
+    {
+        return m_offset + m_buffers[m_current].used;
+    }
+
+    bool AsyncFileWriter::isAsync() const
+    {
+        return m_ring != nullptr;
+    }
+
+    bool AsyncFileWriter::isDirect() const
+    {
+        return m_direct;
+    }
+
+    void AsyncFileWriter::submit(Buffer& buffer)
+    {
+        buffer.offset = m_offset;
+        m_offset += buffer.used;
+        if (m_ring) {
+            const auto idx = static_cast<size_t>(&buffer - m_buffers.data());
+            if (int error = m_ring->push(m_fd, idx, buffer.data, buffer.used,
+                                         buffer.offset))
+                throw_error(m_file, "submit write to", error);
+            buffer.busy = true;
+            ++m_inFlight;
+        } else {
+            write_at(buffer.data, buffer.used, buffer.offset);
+        }
+    }
+
+    void AsyncFileWriter::complete()
+    {
+        size_t idx;
+        int res;
+        if (int error = m_ring->pop(idx, res))
+            throw_error(m_file, "wait for write to", error);
+
+        --m_inFlight;
+        Buffer& buffer = m_buffers[idx];
+        buffer.busy = false;
+        if (res < 0)
+            throw_error(m_file, "write", -res);
+
+        // Short write is rare, the rest is written right away.
+        // Direct write has to go on from block boundary
+        auto written = static_cast<size_t>(res);
+        if (m_direct)
+            written = written / block_size * block_size;
+        if (written < buffer.used)
+            write_at(buffer.data + written, buffer.used - written,
+                     buffer.offset + written);
+    }
+
+    void AsyncFileWriter::write_at(const uint8_t* data, size_t size,
+                                   uint64_t offset)
+    {
+        while (size > 0) {
+            const ssize_t n = pwrite(m_fd, data, size, offset);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                throw_error(m_file, "write", n < 0 ? errno : EIO);
+
+            auto done = static_cast<size_t>(n);
+            if (m_direct && done < size) {
+                done = done / block_size * block_size;
+                // Less than block is written, the rest goes through cache
+                if (done == 0
+                    && fcntl(m_fd, F_SETFL,
+                             fcntl(m_fd, F_GETFL) & ~O_DIRECT) == -1)
+                    throw_error(m_file, "write", errno);
+            }
+            data += done;
+            size -= done;
+            offset += done;
+        }
+    }
+
+    void AsyncFileWriter::close_file()
+    {
+        if (m_fd >= 0)
+            close(m_fd);
+        m_fd = -1;
+    }
+
+    void sync_directory(const std::string& file)
+    {
+        std::string dir = std::filesystem::path(file).parent_path().string();
+        if (dir.empty())
+            dir = ".";
+
+        const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            throw_error(dir, "open directory", errno);
+
+        const int res = fsync(fd);
+        const int error = errno;
+        close(fd);
+        if (res == -1)
+            throw_error(dir, "sync directory", error);
+    }
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <vector>
+#include <boost/format.hpp>
+
+#include "utils/checkpointer.hpp"
+#include "utils/logger.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::Logger;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const std::string checkpoint_prefix = "checkpoint_";
+    const std::string checkpoint_ext = ".lifesnap";
+
+    struct CheckpointFile
+    {
+        size_t number;
+        fs::path path;
+    };
+
+    /**
+     * Find checkpoint files in directory
+     * @param dir
+     * @return files sorted from oldest to newest
+     */
+    std::vector<CheckpointFile> list_checkpoints(const std::string& dir)
+    {
+        std::vector<CheckpointFile> files;
+        std::error_code ec;
+        for (const auto& entry: fs::directory_iterator(dir, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (!name.starts_with(checkpoint_prefix)
+                || !name.ends_with(checkpoint_ext))
+                continue;
+
+            const char* begin = name.data() + checkpoint_prefix.size();
+            const char* end = name.data() + name.size() - checkpoint_ext.size();
+            size_t number = 0;
+            auto [ptr, err] = std::from_chars(begin, end, number);
+            if (err == std::errc() && ptr == end)
+                files.push_back({number, entry.path()});
+        }
+
+        std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+            return a.number < b.number;
+        });
+
+        return files;
+    }
+}
+
+namespace utils
+{
+    Checkpointer::Checkpointer(std::string dir, size_t keep, bool directIo) :
+            m_dir(std::move(dir)), m_keep(std::max<size_t>(keep, 1)),
+            m_directIo(directIo), m_next(1), m_info{}, m_busy(false),
+            m_terminate(false)
+    {
+        std::error_code ec;
+        fs::create_directories(m_dir, ec);
+        if (ec)
+            throw FSException((format("Can't create directory %s: %s\n")
+                               % m_dir % ec.message()).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        // Numbers continue after previous runs, so their
+        // checkpoints are removed first
+        auto files = list_checkpoints(m_dir);
+        if (!files.empty())
+            m_next = files.back().number + 1;
+
+        m_thread = std::thread(&Checkpointer::loop, this);
+    }
+
+    Checkpointer::~Checkpointer()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_terminate = true;
+        }
+
+        m_hasJob.notify_one();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    bool Checkpointer::checkpoint(const FieldComponent& field,
+                                  const snapshot::SnapshotInfo& info)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_busy)
+                return false;
+        }
+
+        // Writer doesn't touch copy until m_busy is set
+        m_copy.sizeX = field.sizeX;
+        m_copy.sizeY = field.sizeY;
+        m_copy.sizeZ = field.sizeZ;
+        m_copy.generation = field.generation;
+        m_copy.alive = field.alive;
+        if (info.hasColors)
+            m_copy.colors = field.colors;
+        else
+            m_copy.colors.clear();
+        m_info = info;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_busy = true;
+        }
+
+        m_hasJob.notify_one();
+        return true;
+    }
+
+    void Checkpointer::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [this] { return !m_busy; });
+    }
+
+    std::optional<snapshot::SnapshotInfo>
+    Checkpointer::restore(const std::string& dir, FieldComponent& field,
+                          ThreadPool* pool)
+    {
+        auto files = list_checkpoints(dir);
+        for (auto it = files.rbegin(); it != files.rend(); ++it) {
+            try {
+                return snapshot::load(it->path.string(), field, pool);
+            } catch (const BaseGameException& e) {
+                Logger::write(e.fileLog(), e.categoryError(), e.what());
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    void Checkpointer::loop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            // Queued checkpoint is written before exit
+            m_hasJob.wait(lock, [this] { return m_busy || m_terminate; });
+            if (!m_busy)
+                break;
+
+            lock.unlock();
+            write_copy();
+            lock.lock();
+
+            m_busy = false;
+            m_finished.notify_all();
+        }
+    }
+
+    void Checkpointer::write_copy()
+    {
+        const fs::path file = fs::path(m_dir)
+                              / (format("%s%08d%s") % checkpoint_prefix
+                                 % m_next % checkpoint_ext).str();
+        try {
+            snapshot::save(file.string(), m_copy, m_info, m_directIo);
+        } catch (const BaseGameException& e) {
+            Logger::write(e.fileLog(), e.categoryError(), e.what());
+            return;
+        }
+        ++m_next;
+
+        auto files = list_checkpoints(m_dir);
+        std::error_code ec;
+        for (size_t i = 0; i + m_keep < files.size(); ++i)
+            fs::remove(files[i].path, ec);
+    }
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "utils/checksum.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CHECKSUM_SSE42
+#endif
+
+namespace
+{
+    // Castagnoli polynomial, bits reversed
+    const uint32_t polynomial = 0x82F63B78u;
+
+    /**
+     * Table i gives register after byte and i zero bytes
+     */
+    constexpr std::array<std::array<uint32_t, 256>, 8> crc_tables = [] {
+        std::array<std::array<uint32_t, 256>, 8> tables{};
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = crc >> 1 ^ (crc & 1 ? polynomial : 0);
+            tables[0][byte] = crc;
+        }
+        for (size_t i = 1; i < tables.size(); ++i)
+            for (size_t byte = 0; byte < 256; ++byte)
+                tables[i][byte] = tables[i - 1][byte] >> 8
+                                  ^ tables[0][tables[i - 1][byte] & 0xFF];
+
+        return tables;
+    }();
+
+    uint64_t load_word(const uint8_t* data)
+    {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        return word;
+    }
+
+    /**
+     * Update CRC register by tables, 8 bytes per step
+     * @param crc
+     * @param data
+     * @param size
+     * @return
+     */
+    uint32_t update_tables(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        const auto& t = crc_tables;
+        for (; size >= 8; size -= 8, data += 8) {
+            const uint64_t word = load_word(data) ^ crc;
+            crc = t[7][word & 0xFF] ^ t[6][word >> 8 & 0xFF]
+                  ^ t[5][word >> 16 & 0xFF] ^ t[4][word >> 24 & 0xFF]
+                  ^ t[3][word >> 32 & 0xFF] ^ t[2][word >> 40 & 0xFF]
+                  ^ t[1][word >> 48 & 0xFF] ^ t[0][word >> 56];
+        }
+        for (; size; --size)
+            crc = t[0][(crc ^ *data++) & 0xFF] ^ crc >> 8;
+
+        return crc;
+    }
+
+#ifdef CHECKSUM_SSE42
+    // Hardware CRC is split to three streams by such parts, CPU
+    // computes them at once and streams are combined after each part
+    const size_t stripe_size = 4096;
+
+    __attribute__((target("sse4.2")))
+    uint32_t zeros_register(uint32_t crc, size_t size)
+    {
+        uint64_t reg = crc;
+        for (size_t i = 0; i < size / 8; ++i)
+            reg = _mm_crc32_u64(reg, 0);
+
+        return static_cast<uint32_t>(reg);
+    }
+
+    /**
+     * Register after stripe of zero bytes. It is linear in register,
+     * so it is sum of table values for each byte of register.
+     */
+    class StripeShift
+    {
+    public:
+        StripeShift() : m_tables{}
+        {
+            uint32_t basis[32];
+            for (size_t bit = 0; bit < 32; ++bit)
+                basis[bit] = zeros_register(uint32_t(1) << bit, stripe_size);
+
+            for (size_t i = 0; i < m_tables.size(); ++i)
+                for (size_t byte = 0; byte < 256; ++byte)
+                    for (size_t bit = 0; bit < 8; ++bit)
+                        if (byte & (1 << bit))
+                            m_tables[i][byte] ^= basis[i * 8 + bit];
+        }
+
+        uint32_t operator()(uint32_t crc) const
+        {
+            return m_tables[0][crc & 0xFF] ^ m_tables[1][crc >> 8 & 0xFF]
+                   ^ m_tables[2][crc >> 16 & 0xFF] ^ m_tables[3][crc >> 24];
+        }
+
+    private:
+        std::array<std::array<uint32_t, 256>, 4> m_tables;
+    };
+
+    /**
+     * Update CRC register by SSE4.2 instruction
+     * @param crc
+     * @param data
+     * @param size
+     * @return
+     */
+    __attribute__((target("sse4.2")))
+    uint32_t update_sse42(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        static const StripeShift shift;
+
+        uint64_t crc0 = crc;
+        for (; size >= 3 * stripe_size; size -= 3 * stripe_size) {
+            // Each instruction waits for previous one of its stream only
+            uint64_t crc1 = 0, crc2 = 0;
+            for (size_t i = 0; i < stripe_size; i += 8) {
+                crc0 = _mm_crc32_u64(crc0, load_word(data + i));
+                crc1 = _mm_crc32_u64(crc1, load_word(data + stripe_size + i));
+                crc2 = _mm_crc32_u64(crc2,
+                                     load_word(data + 2 * stripe_size + i));
+            }
+            crc0 = shift(shift(static_cast<uint32_t>(crc0))
+                         ^ static_cast<uint32_t>(crc1))
+                   ^ static_cast<uint32_t>(crc2);
+            data += 3 * stripe_size;
+        }
+
+        for (; size >= 8; size -= 8, data += 8)
+            crc0 = _mm_crc32_u64(crc0, load_word(data));
+        for (; size; --size)
+            crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *data++);
+
+        return static_cast<uint32_t>(crc0);
+    }
+#endif
+
+    using Update = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+    Update select_update()
+    {
+#ifdef CHECKSUM_SSE42
+        if (__builtin_cpu_supports("sse4.2"))
+            return update_sse42;
+#endif
+        return update_tables;
+    }
+}
+
+namespace utils::checksum
+{
+    uint32_t crc32c(const void* data, size_t size, uint32_t crc)
+    {
+        static const Update update = select_update();
+        return ~update(~crc, static_cast<const uint8_t*>(data), size);
+    }
+
+    bool isHardware()
+    {
+        return select_update() != update_tables;
+    }
+
+    std::vector<size_t> findBroken(size_t count,
+                                   const std::function<bool(size_t)>& isValid,
+                                   ThreadPool* pool)
+    {
+        std::vector<size_t> broken;
+        if (!pool || pool->getThreadsCount() < 2 || count < 2) {
+            for (size_t i = 0; i < count; ++i)
+                if (!isValid(i))
+                    broken.push_back(i);
+
+            return broken;
+        }
+
+        // Several parts per thread even out slow items
+        const size_t parts = std::min(count, pool->getThreadsCount() * 4);
+        std::vector<std::vector<size_t>> found(parts);
+        auto func = [&](size_t part) {
+            for (size_t i = count * part / parts;
+                 i < count * (part + 1) / parts; ++i)
+                if (!isValid(i))
+                    found[part].push_back(i);
+        };
+        for (size_t part = 0; part < parts; ++part)
+            pool->addJob(func, part);
+        pool->waitForFinish();
+
+        for (const auto& part: found)
+            broken.insert(broken.end(), part.begin(), part.end());
+
+        return broken;
+    }
+}
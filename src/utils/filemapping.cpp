@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <boost/format.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/filemapping.hpp"
+#include "utils/logger.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace utils
+{
+    FileMapping::FileMapping(const std::string& file, bool writable) :
+            m_data(nullptr), m_size(0)
+    {
+        int fd = open(file.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd == -1)
+            throw FSException((format("Can't open %s: %s\n")
+                               % file % std::strerror(errno)).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        struct stat st{};
+        if (fstat(fd, &st) == -1) {
+            close(fd);
+            throw FSException((format("Can't stat %s\n") % file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+        }
+
+        // Empty file can't be mapped
+        if (st.st_size == 0) {
+            close(fd);
+            return;
+        }
+
+        void* data = writable
+                     ? mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, 0)
+                     : mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            throw FSException((format("Can't map %s\n") % file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        m_data = data;
+        m_size = st.st_size;
+        madvise(m_data, m_size, MADV_SEQUENTIAL);
+    }
+
+    FileMapping::~FileMapping()
+    {
+        if (m_data)
+            munmap(m_data, m_size);
+    }
+
+    const uint8_t* FileMapping::data() const
+    {
+        return static_cast<const uint8_t*>(m_data);
+    }
+
+    uint8_t* FileMapping::data()
+    {
+        return static_cast<uint8_t*>(m_data);
+    }
+
+    size_t FileMapping::size() const
+    {
+        return m_size;
+    }
+
+    void FileMapping::advise(size_t offset, size_t size, int advice) const
+    {
+        static const size_t page_size = sysconf(_SC_PAGESIZE);
+        offset = std::min(offset, m_size);
+        size = std::min(size, m_size - offset);
+        if (size == 0)
+            return;
+
+        const size_t begin = offset / page_size * page_size;
+        madvise(static_cast<uint8_t*>(m_data) + begin, offset + size - begin,
+                advice);
+    }
+
+    void FileMapping::sync() const
+    {
+        if (m_data && msync(m_data, m_size, MS_SYNC) == -1)
+            throw FSException((format("Can't write mapped file: %s\n")
+                               % std::strerror(errno)).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+    }
+}
@@ -0,0 +1,274 @@
+#include <algorithm>
+
+#include "utils/history.hpp"
+#include "utils/snapshot.hpp"
+#include "utils/varint.hpp"
+
+namespace utils
+{
+    History::History(size_t memoryBudget) : m_budget(memoryBudget), m_used(0),
+                                            m_sinceKeyframe(0),
+                                            m_keyframeSize(0), m_current(0)
+    {}
+
+    void History::setMemoryBudget(size_t memoryBudget)
+    {
+        m_budget = memoryBudget;
+    }
+
+    void History::clear()
+    {
+        m_steps.clear();
+        m_keyframes.clear();
+        m_used = 0;
+        m_sinceKeyframe = 0;
+        m_keyframeSize = 0;
+    }
+
+    void History::push(const FieldComponent& field,
+                       const std::vector<uint8_t>& prevAlive)
+    {
+        truncate();
+        if ((!m_steps.empty() || !m_keyframes.empty())
+            && field.generation != m_current + 1)
+            clear();
+
+        // Cells of chunk go in index order along z only,
+        // so gaps between runs may be negative
+        m_runs.clear();
+        m_colors.clear();
+        int64_t runStart = 0, runEnd = 0, prevEnd = 0;
+        auto flush_run = [this, &runStart, &runEnd, &prevEnd] {
+            if (runStart == runEnd)
+                return;
+            put_varint(m_runs, zigzag(runStart - prevEnd));
+            put_varint(m_runs, runEnd - runStart);
+            prevEnd = runEnd;
+        };
+
+        for (size_t idx = 0; idx < field.chunksCount(); ++idx) {
+            if (field.chunkVersions[idx] != field.version)
+                continue;
+
+            field.forEachCell(field.getChunk(idx), [&](size_t, size_t, size_t,
+                                                       size_t i) {
+                if ((field.alive[i] != 0) == (prevAlive[i] != 0))
+                    return;
+
+                // Dying cell keeps its color
+                m_colors.push_back(field.colors[i]);
+                const auto cell = static_cast<int64_t>(i);
+                if (cell != runEnd) {
+                    flush_run();
+                    runStart = cell;
+                }
+                runEnd = cell + 1;
+            });
+        }
+        flush_run();
+
+        m_steps.push_back({field.generation,
+                           {m_runs.begin(), m_runs.end()},
+                           {m_colors.begin(), m_colors.end()}});
+        m_current = field.generation;
+
+        const size_t size = size_of(m_steps.back());
+        m_used += size;
+        m_sinceKeyframe += size;
+
+        // Size of keyframe is guessed by the previous one. Keyframe isn't
+        // worth taking if a few of them fill the whole budget
+        if (m_keyframeSize == 0)
+            m_keyframeSize = (field.size() + 7) / 8 + sizeof(uint32_t)
+                             * std::count(field.alive.begin(),
+                                          field.alive.end(), 1);
+        if (m_sinceKeyframe >= m_keyframeSize
+            && m_keyframeSize <= m_budget / 4)
+            take_keyframe(field);
+
+        evict();
+    }
+
+    bool History::seek(uint64_t generation, FieldComponent& field)
+    {
+        if (generation < getFirstGeneration()
+            || generation > getLastGeneration())
+            return false;
+
+        auto cost = [this](uint64_t from, uint64_t to) {
+            size_t sum = 0;
+            for (uint64_t gen = from + 1; gen <= to; ++gen)
+                sum += size_of(step(gen));
+            return sum;
+        };
+
+        const size_t directCost = generation < m_current
+                                  ? cost(generation, m_current)
+                                  : cost(m_current, generation);
+
+        auto keyframe = std::find_if(m_keyframes.rbegin(), m_keyframes.rend(),
+                                     [generation](const Keyframe& key) {
+                                         return key.generation <= generation;
+                                     });
+
+        if (keyframe != m_keyframes.rend()
+            && size_of(*keyframe) + cost(keyframe->generation, generation)
+               < directCost) {
+            restore(*keyframe, field);
+            for (uint64_t gen = keyframe->generation + 1; gen <= generation;
+                 ++gen)
+                apply(step(gen), field);
+        } else if (generation < m_current) {
+            for (uint64_t gen = m_current; gen > generation; --gen)
+                apply(step(gen), field);
+        } else {
+            for (uint64_t gen = m_current + 1; gen <= generation; ++gen)
+                apply(step(gen), field);
+        }
+
+        field.generation = generation;
+        m_current = generation;
+        return true;
+    }
+
+    bool History::empty() const
+    {
+        return m_steps.empty();
+    }
+
+    uint64_t History::getFirstGeneration() const
+    {
+        return m_steps.empty() ? m_current : m_steps.front().generation - 1;
+    }
+
+    uint64_t History::getLastGeneration() const
+    {
+        return m_steps.empty() ? m_current : m_steps.back().generation;
+    }
+
+    uint64_t History::getCurrentGeneration() const
+    {
+        return m_current;
+    }
+
+    size_t History::getMemoryUsage() const
+    {
+        return m_used;
+    }
+
+    void History::apply(const Step& step, FieldComponent& field)
+    {
+        ++field.version;
+
+        const uint8_t* runs = step.runs.data();
+        const uint8_t* end = runs + step.runs.size();
+        auto color = step.colors.begin();
+        int64_t prevEnd = 0;
+        uint64_t gap, count;
+        while (get_varint(runs, end, gap) && get_varint(runs, end, count)) {
+            const auto start = static_cast<size_t>(prevEnd + unzigzag(gap));
+            for (size_t i = start; i < start + count; ++i, ++color) {
+                field.alive[i] = !field.alive[i];
+                if (field.alive[i])
+                    field.colors[i] = *color;
+
+                const size_t z = i % field.sizeZ;
+                const size_t y = i / field.sizeZ % field.sizeY;
+                const size_t x = i / field.sizeZ / field.sizeY;
+                field.markCellChanged(x, y, z);
+            }
+            prevEnd = static_cast<int64_t>(start + count);
+        }
+    }
+
+    void History::restore(const Keyframe& keyframe, FieldComponent& field)
+    {
+        ++field.version;
+        std::fill(field.chunkVersions.begin(), field.chunkVersions.end(),
+                  field.version);
+
+        snapshot::unpack_alive(keyframe.bits.data(), field.size(),
+                               field.alive.data());
+        auto color = keyframe.colors.begin();
+        for (size_t i = 0; i < field.size(); ++i)
+            if (field.alive[i])
+                field.colors[i] = *color++;
+    }
+
+    size_t History::size_of(const Step& step)
+    {
+        return sizeof(Step) + step.runs.size()
+               + step.colors.size() * sizeof(uint32_t);
+    }
+
+    size_t History::size_of(const Keyframe& keyframe)
+    {
+        return sizeof(Keyframe) + keyframe.bits.size()
+               + keyframe.colors.size() * sizeof(uint32_t);
+    }
+
+    void History::take_keyframe(const FieldComponent& field)
+    {
+        Keyframe keyframe{field.generation,
+                          std::vector<uint8_t>((field.size() + 7) / 8), {}};
+        const size_t aliveCount = snapshot::pack_alive(
+                field.alive.data(), field.size(), keyframe.bits.data());
+        keyframe.colors.reserve(aliveCount);
+        for (size_t i = 0; i < field.size(); ++i)
+            if (field.alive[i])
+                keyframe.colors.push_back(field.colors[i]);
+
+        m_keyframeSize = size_of(keyframe);
+        m_used += m_keyframeSize;
+        m_keyframes.push_back(std::move(keyframe));
+        m_sinceKeyframe = 0;
+    }
+
+    void History::truncate()
+    {
+        while (!m_steps.empty() && m_steps.back().generation > m_current) {
+            m_used -= size_of(m_steps.back());
+            m_steps.pop_back();
+        }
+        while (!m_keyframes.empty()
+               && m_keyframes.back().generation > m_current) {
+            m_used -= size_of(m_keyframes.back());
+            m_keyframes.pop_back();
+        }
+
+        const uint64_t lastKeyframe = m_keyframes.empty()
+                                      ? 0 : m_keyframes.back().generation;
+        m_sinceKeyframe = 0;
+        for (auto it = m_steps.rbegin();
+             it != m_steps.rend() && it->generation > lastKeyframe; ++it)
+            m_sinceKeyframe += size_of(*it);
+    }
+
+    void History::evict()
+    {
+        auto drop_keyframes = [this] {
+            // Keyframes older than the first step can't be reached
+            while (!m_keyframes.empty()
+                   && m_keyframes.front().generation < getFirstGeneration()) {
+                m_used -= size_of(m_keyframes.front());
+                m_keyframes.pop_front();
+            }
+        };
+
+        while (m_used > m_budget && !m_steps.empty()) {
+            const size_t size = size_of(m_steps.front());
+            if (m_keyframes.empty()
+                || m_steps.front().generation > m_keyframes.back().generation)
+                m_sinceKeyframe -= std::min(m_sinceKeyframe, size);
+            m_used -= size;
+            m_steps.pop_front();
+            drop_keyframes();
+        }
+        drop_keyframes();
+    }
+
+    const History::Step& History::step(uint64_t generation) const
+    {
+        return m_steps[generation - m_steps.front().generation];
+    }
+}
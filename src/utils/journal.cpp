@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <cstring>
+#include <boost/format.hpp>
+
+#include "utils/journal.hpp"
+#include "utils/logger.hpp"
+#include "utils/varint.hpp"
+#include "utils/checksum.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace
+{
+    const char journal_magic[8] = {'L', 'I', 'F', 'E', 'J', 'R', 'N', 'L'};
+    const uint32_t neighbours_count = 14;
+    const uint32_t colors_flag = 1;
+    const uint32_t keyframe_record = 0;
+    const uint32_t delta_record = 1;
+    // Color of live cells in journals without colors
+    const uint32_t white = 0xFFFFFFFFu;
+    const uint64_t max_side = 1 << 16;
+    const uint64_t max_cells = uint64_t(1) << 36;
+
+    struct JournalHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t sizeX;
+        uint64_t sizeY;
+        uint64_t sizeZ;
+        uint32_t neirCount;
+        uint32_t neirCountDie;
+        uint32_t neighbours;
+        uint32_t boundary;
+        uint32_t flags;
+        uint32_t keyframeInterval;
+    };
+
+    /**
+     * Each record starts with this header, payload goes right after it
+     */
+    struct RecordHeader
+    {
+        uint32_t type;
+        // CRC32C of header with this field set to zero continued by
+        // payload, zero in version 1
+        uint32_t checksum;
+        uint64_t generation;
+        uint64_t payloadSize;
+    };
+
+    static_assert(sizeof(JournalHeader) == 64);
+    static_assert(sizeof(RecordHeader) == 24);
+
+    uint32_t record_checksum(RecordHeader header, const uint8_t* payload)
+    {
+        using utils::checksum::crc32c;
+
+        header.checksum = 0;
+        return crc32c(payload, header.payloadSize,
+                      crc32c(&header, sizeof(header)));
+    }
+
+    void put_color(std::vector<uint8_t>& out, uint32_t color)
+    {
+        uint16_t packed = utils::snapshot::to_rgb565(color);
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&packed);
+        out.insert(out.end(), bytes, bytes + sizeof(packed));
+    }
+
+    [[noreturn]] void throw_broken(const std::string& file,
+                                   const std::string& reason)
+    {
+        throw FSException((format("Broken journal %s: %s\n")
+                           % file % reason).str(),
+                          program_log_file_name(), Category::FILE_ERROR);
+    }
+
+    /**
+     * Bounds checked reader of record payload
+     */
+    class PayloadReader
+    {
+    public:
+        PayloadReader(const uint8_t* data, size_t size,
+                      const std::string& file) :
+                m_data(data), m_end(data + size), m_file(file)
+        {}
+
+        uint64_t varint()
+        {
+            uint64_t val;
+            if (!utils::get_varint(m_data, m_end, val))
+                throw_broken(m_file, "truncated delta");
+
+            return val;
+        }
+
+        uint32_t color()
+        {
+            uint16_t packed;
+            read(&packed, sizeof(packed));
+            return utils::snapshot::from_rgb565(packed);
+        }
+
+        void read(void* data, size_t size)
+        {
+            if (static_cast<size_t>(m_end - m_data) < size)
+                throw_broken(m_file, "truncated record");
+            std::memcpy(data, m_data, size);
+            m_data += size;
+        }
+
+        const uint8_t* data() const
+        {
+            return m_data;
+        }
+
+        size_t left() const
+        {
+            return m_end - m_data;
+        }
+
+    private:
+        const uint8_t* m_data;
+        const uint8_t* m_end;
+        const std::string& m_file;
+    };
+}
+
+namespace utils::journal
+{
+    JournalWriter::JournalWriter(const std::string& file,
+                                 const FieldComponent& field,
+                                 const snapshot::SnapshotInfo& info,
+                                 size_t keyframeInterval) :
+            m_file(file), m_hasColors(info.hasColors),
+            m_keyframeInterval(std::max<size_t>(keyframeInterval, 1)),
+            m_sinceKeyframe(0)
+    {
+        m_out.open(m_file, std::ios::binary | std::ios::trunc);
+        if (!m_out)
+            throw FSException((format("Can't open %s\n") % m_file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        JournalHeader header{};
+        std::memcpy(header.magic, journal_magic, sizeof(journal_magic));
+        header.version = journal_version;
+        header.headerSize = sizeof(header);
+        header.sizeX = field.sizeX;
+        header.sizeY = field.sizeY;
+        header.sizeZ = field.sizeZ;
+        header.neirCount = info.neirCount;
+        header.neirCountDie = info.neirCountDie;
+        header.neighbours = neighbours_count;
+        header.boundary = static_cast<uint32_t>(info.boundary);
+        header.flags = m_hasColors ? colors_flag : 0;
+        header.keyframeInterval = m_keyframeInterval;
+        m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        write_keyframe(field);
+    }
+
+    void JournalWriter::append(const FieldComponent& field)
+    {
+        if (++m_sinceKeyframe >= m_keyframeInterval) {
+            m_sinceKeyframe = 0;
+            write_keyframe(field);
+        } else {
+            write_delta(field);
+        }
+    }
+
+    void JournalWriter::write_keyframe(const FieldComponent& field)
+    {
+        const size_t cells = field.size();
+        m_payload.resize((cells + 7) / 8);
+        snapshot::pack_alive(field.alive.data(), cells, m_payload.data());
+
+        if (m_hasColors)
+            for (size_t i = 0; i < cells; ++i)
+                if (field.alive[i])
+                    put_color(m_payload, field.colors[i]);
+
+        write_record(keyframe_record, field.generation);
+        m_prev = field.alive;
+    }
+
+    void JournalWriter::write_delta(const FieldComponent& field)
+    {
+        const size_t cells = field.size();
+        const uint8_t* cur = field.alive.data();
+        const uint8_t* prev = m_prev.data();
+        auto flipped = [cur, prev](size_t i) {
+            return (cur[i] != 0) != (prev[i] != 0);
+        };
+
+        // Size of runs goes first, it is known only after runs
+        m_payload.assign(sizeof(uint64_t), 0);
+        std::vector<uint32_t> born;
+        size_t end = 0;
+        for (size_t i = 0; i < cells;) {
+            // Most of field doesn't change, skip it by words
+            if (i + 8 <= cells && std::memcmp(cur + i, prev + i, 8) == 0) {
+                i += 8;
+                continue;
+            }
+            if (!flipped(i)) {
+                ++i;
+                continue;
+            }
+
+            const size_t start = i;
+            for (; i < cells && flipped(i); ++i)
+                if (m_hasColors && cur[i])
+                    born.push_back(field.colors[i]);
+
+            utils::put_varint(m_payload, start - end);
+            utils::put_varint(m_payload, i - start);
+            end = i;
+        }
+
+        const uint64_t runsSize = m_payload.size() - sizeof(uint64_t);
+        std::memcpy(m_payload.data(), &runsSize, sizeof(runsSize));
+        for (uint32_t color: born)
+            put_color(m_payload, color);
+
+        write_record(delta_record, field.generation);
+        m_prev = field.alive;
+    }
+
+    void JournalWriter::write_record(uint32_t type, uint64_t generation)
+    {
+        RecordHeader header{type, 0, generation, m_payload.size()};
+        header.checksum = record_checksum(header, m_payload.data());
+        m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        m_out.write(reinterpret_cast<const char*>(m_payload.data()),
+                    m_payload.size());
+        m_out.flush();
+
+        if (!m_out)
+            throw FSException((format("Unable to write journal %s\n")
+                               % m_file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+    }
+
+    JournalReader::JournalReader(const std::string& file, ThreadPool* pool) :
+            m_file(file), m_mapping(std::make_unique<FileMapping>(file)),
+            m_info{}, m_sizeX(0), m_sizeY(0), m_sizeZ(0), m_current(0)
+    {
+        const uint8_t* data = m_mapping->data();
+        const size_t size = m_mapping->size();
+        if (size < sizeof(JournalHeader))
+            throw_broken(m_file, "file is too small");
+
+        JournalHeader header{};
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, journal_magic, sizeof(journal_magic)))
+            throw_broken(m_file, "wrong magic");
+        // Version 1 is the same without checksums
+        if ((header.version != journal_version && header.version != 1)
+            || header.headerSize != sizeof(header))
+            throw_broken(m_file, "unsupported version");
+        if (header.neighbours != neighbours_count
+            || header.boundary
+               != static_cast<uint32_t>(snapshot::Boundary::DEAD))
+            throw_broken(m_file, "unsupported rule");
+        if (header.sizeX > max_side || header.sizeY > max_side
+            || header.sizeZ > max_side
+            || header.sizeX * header.sizeY * header.sizeZ > max_cells)
+            throw_broken(m_file, "field is too large");
+
+        m_sizeX = header.sizeX;
+        m_sizeY = header.sizeY;
+        m_sizeZ = header.sizeZ;
+        m_info = {header.neirCount, header.neirCountDie,
+                  snapshot::Boundary::DEAD,
+                  (header.flags & colors_flag) != 0};
+
+        size_t offset = sizeof(header);
+        while (size - offset >= sizeof(RecordHeader)) {
+            RecordHeader record{};
+            std::memcpy(&record, data + offset, sizeof(record));
+            offset += sizeof(record);
+            // Record of crashed run
+            if (record.payloadSize > size - offset
+                || (record.type != keyframe_record
+                    && record.type != delta_record))
+                break;
+
+            m_records.push_back({record.type, record.checksum,
+                                 record.generation, data + offset,
+                                 record.payloadSize});
+            offset += record.payloadSize;
+        }
+
+        if (header.version == journal_version) {
+            auto broken = utils::checksum::findBroken(
+                    m_records.size(), [this](size_t idx) {
+                        const Record& record = m_records[idx];
+                        return record_checksum({record.type, 0,
+                                                record.generation,
+                                                record.size},
+                                               record.payload)
+                               == record.checksum;
+                    }, pool);
+
+            // Broken records at the end are left by crash like partial one,
+            // record followed by good ones is broken by something else
+            while (!broken.empty() && broken.back() + 1 == m_records.size()) {
+                broken.pop_back();
+                m_records.pop_back();
+            }
+            if (!broken.empty())
+                throw_broken(m_file, (format("checksum mismatch in record %d "
+                                             "of generation %d (%d broken)")
+                                      % broken.front()
+                                      % m_records[broken.front()].generation
+                                      % broken.size()).str());
+        }
+
+        if (m_records.empty() || m_records.front().type != keyframe_record)
+            throw_broken(m_file, "no keyframe");
+        m_current = m_records.size();
+    }
+
+    const snapshot::SnapshotInfo& JournalReader::getInfo() const
+    {
+        return m_info;
+    }
+
+    uint64_t JournalReader::getFirstGeneration() const
+    {
+        return m_records.front().generation;
+    }
+
+    uint64_t JournalReader::getLastGeneration() const
+    {
+        return m_records.back().generation;
+    }
+
+    void JournalReader::seek(uint64_t generation, FieldComponent& field)
+    {
+        auto it = std::upper_bound(m_records.begin(), m_records.end(),
+                                   generation,
+                                   [](uint64_t gen, const Record& record) {
+                                       return gen < record.generation;
+                                   });
+        const size_t target = it == m_records.begin()
+                              ? 0 : it - m_records.begin() - 1;
+
+        size_t keyframe = target;
+        while (m_records[keyframe].type != keyframe_record)
+            --keyframe;
+
+        // Going forward from current generation is cheaper
+        // than loading keyframe again
+        size_t idx = keyframe;
+        if (m_current < m_records.size() && m_current >= keyframe
+            && m_current <= target)
+            idx = m_current + 1;
+        else
+            apply_keyframe(m_records[idx++], field);
+
+        for (; idx <= target; ++idx) {
+            if (m_records[idx].type == keyframe_record)
+                apply_keyframe(m_records[idx], field);
+            else
+                apply_delta(m_records[idx], field);
+        }
+
+        m_current = target;
+    }
+
+    bool JournalReader::next(FieldComponent& field)
+    {
+        if (m_current == m_records.size()) {
+            seek(getFirstGeneration(), field);
+            return true;
+        }
+        if (m_current + 1 == m_records.size())
+            return false;
+
+        const Record& record = m_records[++m_current];
+        if (record.type == keyframe_record)
+            apply_keyframe(record, field);
+        else
+            apply_delta(record, field);
+
+        return true;
+    }
+
+    void JournalReader::apply_keyframe(const Record& record,
+                                       FieldComponent& field)
+    {
+        const size_t cells = m_sizeX * m_sizeY * m_sizeZ;
+        const size_t bitsSize = (cells + 7) / 8;
+        if (record.size < bitsSize)
+            throw_broken(m_file, "truncated keyframe");
+
+        if (field.sizeX != m_sizeX || field.sizeY != m_sizeY
+            || field.sizeZ != m_sizeZ) {
+            field.resize(m_sizeX, m_sizeY, m_sizeZ);
+        } else {
+            ++field.version;
+            std::fill(field.chunkVersions.begin(), field.chunkVersions.end(),
+                      field.version);
+        }
+
+        snapshot::unpack_alive(record.payload, cells, field.alive.data());
+        PayloadReader colors(record.payload + bitsSize, record.size - bitsSize,
+                             m_file);
+        for (size_t i = 0; i < cells; ++i)
+            if (field.alive[i])
+                field.colors[i] = m_info.hasColors ? colors.color() : white;
+
+        field.generation = record.generation;
+    }
+
+    void JournalReader::apply_delta(const Record& record, FieldComponent& field)
+    {
+        const size_t cells = field.size();
+        PayloadReader payload(record.payload, record.size, m_file);
+        uint64_t runsSize;
+        payload.read(&runsSize, sizeof(runsSize));
+        if (runsSize > payload.left())
+            throw_broken(m_file, "truncated delta");
+
+        PayloadReader runs(payload.data(), runsSize, m_file);
+        PayloadReader colors(payload.data() + runsSize,
+                             payload.left() - runsSize, m_file);
+
+        ++field.version;
+        size_t end = 0;
+        while (runs.left()) {
+            const uint64_t start = end + runs.varint();
+            const uint64_t count = runs.varint();
+            if (start > cells || count > cells - start)
+                throw_broken(m_file, "wrong delta");
+
+            for (end = start; end < start + count; ++end) {
+                const bool alive = !field.alive[end];
+                field.alive[end] = alive;
+                if (alive)
+                    field.colors[end] = m_info.hasColors ? colors.color()
+                                                         : white;
+
+                const size_t z = end % m_sizeZ;
+                const size_t y = end / m_sizeZ % m_sizeY;
+                const size_t x = end / m_sizeZ / m_sizeY;
+                field.markCellChanged(x, y, z);
+            }
+        }
+
+        field.generation = record.generation;
+    }
+}
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <random>
+#include <vector>
+#include <sys/mman.h>
+#include <boost/format.hpp>
+
+#include "utils/mappedfield.hpp"
+#include "utils/logger.hpp"
+#include "utils/asyncwriter.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace
+{
+    // Input is read ahead and dropped behind by such parts
+    const size_t prefetch_size = 64 << 20;
+
+    /**
+     * Pack cells starting at any bit. Bits after the last cell are
+     * cleared up to the end of byte
+     * @param cells
+     * @param count
+     * @param bits
+     * @param offset first bit
+     * @return count of live cells
+     */
+    size_t pack_bits(const uint8_t* cells, size_t count, uint8_t* bits,
+                     size_t offset)
+    {
+        if (offset % 8 == 0)
+            return utils::snapshot::pack_alive(cells, count, bits + offset / 8);
+
+        size_t aliveCount = 0;
+        for (size_t i = 0; i < count; ++i, ++offset) {
+            const auto mask = static_cast<uint8_t>(1 << offset % 8);
+            if (cells[i]) {
+                bits[offset / 8] |= mask;
+                ++aliveCount;
+            } else {
+                bits[offset / 8] &= ~mask;
+            }
+        }
+
+        return aliveCount;
+    }
+
+    /**
+     * Next generation of row, rows start with border cell
+     * @param cur row of current plane
+     * @param prev the same row of previous plane
+     * @param next the same row of next plane
+     * @param rowSize distance between rows in planes
+     * @param count cells in row
+     * @param life
+     * @param die
+     * @param result
+     */
+    void compute_row(const uint8_t* cur, const uint8_t* prev,
+                     const uint8_t* next, size_t rowSize, size_t count,
+                     uint8_t life, uint8_t die, uint8_t* __restrict result)
+    {
+        const uint8_t* up = cur - rowSize;
+        const uint8_t* down = cur + rowSize;
+        const uint8_t* prevUp = prev - rowSize;
+        const uint8_t* prevDown = prev + rowSize;
+        const uint8_t* nextUp = next - rowSize;
+        const uint8_t* nextDown = next + rowSize;
+        for (size_t z = 0; z < count; ++z) {
+            const uint8_t n = up[z + 1] + down[z + 1] + cur[z] + cur[z + 2]
+                              + prev[z + 1] + next[z + 1]
+                              + prevUp[z] + prevUp[z + 2]
+                              + prevDown[z] + prevDown[z + 2]
+                              + nextUp[z] + nextUp[z + 2]
+                              + nextDown[z] + nextDown[z + 2];
+            result[z] = (n >= life) & ((n < die) | (cur[z + 1] ^ 1));
+        }
+    }
+}
+
+namespace utils
+{
+    MappedField::MappedField(const std::string& file) :
+            m_file(file), m_layout(snapshot::readLayout(file)),
+            m_mapping(std::make_unique<FileMapping>(file)), m_aliveCount(0)
+    {}
+
+    void MappedField::create(const std::string& file, uint64_t sizeX,
+                             uint64_t sizeY, uint64_t sizeZ,
+                             const snapshot::SnapshotInfo& info,
+                             double density, uint64_t seed)
+    {
+        const snapshot::SnapshotLayout layout = snapshot::create(
+                file, sizeX, sizeY, sizeZ, 0, info);
+        FileMapping mapping(file, true);
+        uint8_t* bits = mapping.data() + layout.aliveOffset;
+
+        // Each random number gives 8 cells, a byte per cell
+        const auto threshold = static_cast<uint64_t>(
+                std::clamp(density, 0.0, 1.0) * 256);
+        const uint64_t cells = sizeX * sizeY * sizeZ;
+        std::mt19937_64 generator(seed);
+        for (uint64_t byte = 0; byte < layout.aliveSize; ++byte) {
+            const uint64_t rnd = generator();
+            const uint64_t bitsCount = std::min<uint64_t>(8, cells - byte * 8);
+            uint8_t packed = 0;
+            for (uint64_t bit = 0; bit < bitsCount; ++bit)
+                packed |= ((rnd >> bit * 8 & 0xFF) < threshold) << bit;
+            bits[byte] = packed;
+
+            // Checksum of block is computed while it is in cache
+            if ((byte + 1) % layout.checksumBlock == 0
+                || byte + 1 == layout.aliveSize)
+                snapshot::writeChecksums(mapping.data(), layout,
+                                         byte / layout.checksumBlock,
+                                         byte / layout.checksumBlock + 1);
+        }
+
+        mapping.sync();
+    }
+
+    void MappedField::step(ThreadPool& pool)
+    {
+        const size_t sizeX = m_layout.sizeX;
+        const size_t sizeY = m_layout.sizeY;
+        const size_t sizeZ = m_layout.sizeZ;
+        const size_t planeCells = sizeY * sizeZ;
+        const size_t rowSize = sizeZ + 2;
+        const size_t planeSize = (sizeY + 2) * rowSize;
+
+        // New generation replaces file only when it is complete
+        const std::string nextFile = m_file + ".next";
+        snapshot::SnapshotLayout nextLayout{};
+        uint64_t aliveCount = 0;
+        try {
+            nextLayout = snapshot::create(
+                    nextFile, sizeX, sizeY, sizeZ, m_layout.generation + 1,
+                    m_layout.info);
+            FileMapping out(nextFile, true);
+            uint8_t* outBits = out.data() + nextLayout.aliveOffset;
+
+            // Rolling window of previous, current and next planes
+            std::array<std::vector<uint8_t>, 3> window;
+            for (auto& plane: window)
+                plane.assign(planeSize, 0);
+            uint8_t* prev = window[0].data();
+            uint8_t* cur = window[1].data();
+            uint8_t* next = window[2].data();
+            std::vector<uint8_t> result(planeCells);
+
+            const auto life = static_cast<uint8_t>(
+                    std::min<uint32_t>(m_layout.info.neirCount, 0xFF));
+            const auto die = static_cast<uint8_t>(
+                    std::min<uint32_t>(m_layout.info.neirCountDie, 0xFF));
+            // Neighbours are 6 faces and 8 corners as in World
+            auto func = [&](size_t startY, size_t endY) {
+                for (size_t y = startY; y < endY; ++y) {
+                    const size_t row = (y + 1) * rowSize;
+                    compute_row(cur + row, prev + row, next + row, rowSize,
+                                sizeZ, life, die, result.data() + y * sizeZ);
+                }
+            };
+
+            // Input blocks are checked just before their planes are read,
+            // output blocks get checksums as soon as they are packed
+            uint64_t checkedBlocks = 0, summedBlocks = 0;
+            auto read_checked = [&](size_t x, uint8_t* plane) {
+                if (m_layout.checksumBlock != 0) {
+                    const uint64_t end = ((x + 1) * planeCells + 7) / 8;
+                    const uint64_t blocks = (end + m_layout.checksumBlock - 1)
+                                            / m_layout.checksumBlock;
+                    snapshot::checkBlocks(m_file, m_mapping->data(), m_layout,
+                                          checkedBlocks, blocks);
+                    checkedBlocks = std::max(checkedBlocks, blocks);
+                }
+                read_plane(x, plane);
+            };
+
+            const size_t inOffset = m_layout.aliveOffset;
+            const size_t outOffset = nextLayout.aliveOffset;
+            size_t prefetched = inOffset, dropped = inOffset;
+            size_t written = outOffset;
+            if (sizeX > 0)
+                read_checked(0, cur);
+            if (sizeX > 1)
+                read_checked(1, next);
+
+            const size_t threadCount = pool.getThreadsCount();
+            const size_t rowsPerJob = (sizeY + threadCount - 1) / threadCount;
+            for (size_t x = 0; x < sizeX; ++x) {
+                // Planes up to x + 2 are needed soon
+                const size_t needed = inOffset + (x + 3) * planeCells / 8;
+                while (prefetched < needed + prefetch_size / 2) {
+                    m_mapping->advise(prefetched, prefetch_size, MADV_WILLNEED);
+                    prefetched += prefetch_size;
+                }
+
+                for (size_t start = 0; start < sizeY; start += rowsPerJob)
+                    pool.addJob(func, start,
+                                std::min(sizeY, start + rowsPerJob));
+                pool.waitForFinish();
+
+                aliveCount += pack_bits(result.data(), planeCells, outBits,
+                                        x * planeCells);
+                const uint64_t packed = x + 1 < sizeX
+                                        ? (x + 1) * planeCells / 8
+                                        : nextLayout.aliveSize;
+                const uint64_t summed = x + 1 < sizeX
+                                        ? packed / nextLayout.checksumBlock
+                                        : snapshot::blocksCount(nextLayout);
+                snapshot::writeChecksums(out.data(), nextLayout, summedBlocks,
+                                         summed);
+                summedBlocks = summed;
+
+                // Planes before x - 1 are read and written for the last time
+                const size_t doneIn = x > 0
+                                      ? inOffset + (x - 1) * planeCells / 8
+                                      : inOffset;
+                if (doneIn >= dropped + prefetch_size) {
+                    m_mapping->advise(dropped, doneIn - dropped, MADV_DONTNEED);
+                    dropped = doneIn;
+                }
+                const size_t doneOut = outOffset + x * planeCells / 8;
+                if (doneOut >= written + prefetch_size) {
+                    out.advise(written, doneOut - written, MADV_DONTNEED);
+                    written = doneOut;
+                }
+
+                std::swap(prev, cur);
+                std::swap(cur, next);
+                if (x + 2 < sizeX)
+                    read_checked(x + 2, next);
+                else
+                    std::fill_n(next, planeSize, 0);
+            }
+
+            out.sync();
+
+            // Old mapping stays valid after rename, so it is
+            // replaced only when the new file is in place
+            std::error_code ec;
+            std::filesystem::rename(nextFile, m_file, ec);
+            if (ec)
+                throw FSException((format("Unable to replace %s: %s\n")
+                                   % m_file % ec.message()).str(),
+                                  program_log_file_name(),
+                                  Category::FILE_ERROR);
+        } catch (const FSException&) {
+            // Unfinished generation is dropped, file is kept
+            std::error_code ec;
+            std::filesystem::remove(nextFile, ec);
+            throw;
+        }
+
+        m_mapping = std::make_unique<FileMapping>(m_file);
+        m_layout = nextLayout;
+        m_aliveCount = aliveCount;
+        utils::sync_directory(m_file);
+    }
+
+    const snapshot::SnapshotLayout& MappedField::getLayout() const
+    {
+        return m_layout;
+    }
+
+    uint64_t MappedField::getAliveCount() const
+    {
+        return m_aliveCount;
+    }
+
+    void MappedField::read_plane(size_t x, uint8_t* plane) const
+    {
+        const size_t sizeY = m_layout.sizeY;
+        const size_t sizeZ = m_layout.sizeZ;
+        const uint8_t* bits = m_mapping->data() + m_layout.aliveOffset;
+        for (size_t y = 0; y < sizeY; ++y)
+            snapshot::unpack_bits(bits, (x * sizeY + y) * sizeZ, sizeZ,
+                        plane + (y + 1) * (sizeZ + 2) + 1);
+    }
+}
@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <boost/format.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+
+#include "utils/pattern.hpp"
+#include "utils/logger.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace
+{
+    using utils::pattern::PlaceResult;
+
+    const size_t read_block_size = 1 << 20;
+    // Voxels read from .vox file at once
+    const size_t voxels_block_size = 1 << 16;
+    // Bigger coordinates, rle counts and positions can't be in any
+    // field, pattern position arithmetic never overflows below it
+    const int64_t max_pattern_position = int64_t(1) << 40;
+
+    [[noreturn]] void throw_broken(const std::string& file, const char* reason)
+    {
+        throw FSException((format("Broken pattern %s: %s\n")
+                           % file % reason).str(),
+                          program_log_file_name(), Category::FILE_ERROR);
+    }
+
+    std::ifstream open_file(const std::string& file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            throw FSException((format("Can't open pattern %s\n") % file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        return in;
+    }
+
+    /**
+     * Put cells of pattern to field
+     */
+    class Placer
+    {
+    public:
+        Placer(FieldComponent& field, const glm::ivec3& offset) :
+                m_field(field), m_offset(offset)
+        {
+            ++m_field.version;
+        }
+
+        /**
+         * Make cell alive, coordinates are within max_pattern_position
+         * @param x
+         * @param y
+         * @param z
+         * @param color RGBA8 color or nullptr to keep cell color
+         */
+        void set(int64_t x, int64_t y, int64_t z,
+                 const uint32_t* color = nullptr)
+        {
+            x += m_offset.x;
+            y += m_offset.y;
+            z += m_offset.z;
+            if (!inside(x, y, z)) {
+                ++m_result.clipped;
+                return;
+            }
+
+            put(x, y, z, color);
+        }
+
+        /**
+         * Make count cells alive along x, only part of run
+         * inside field is walked. Coordinates and count are within
+         * max_pattern_position, so x + count doesn't overflow
+         */
+        void setRun(int64_t x, int64_t y, int64_t z, int64_t count)
+        {
+            x += m_offset.x;
+            y += m_offset.y;
+            z += m_offset.z;
+            const int64_t begin = std::max<int64_t>(x, 0);
+            const int64_t end = std::min(x + count,
+                                         static_cast<int64_t>(m_field.sizeX));
+            if (begin >= end || !inside(begin, y, z)) {
+                m_result.clipped += count;
+                return;
+            }
+
+            for (int64_t i = begin; i < end; ++i)
+                put(i, y, z, nullptr);
+            m_result.clipped += count - (end - begin);
+        }
+
+        const PlaceResult& getResult() const
+        {
+            return m_result;
+        }
+
+    private:
+        bool inside(int64_t x, int64_t y, int64_t z) const
+        {
+            return x >= 0 && y >= 0 && z >= 0
+                   && x < static_cast<int64_t>(m_field.sizeX)
+                   && y < static_cast<int64_t>(m_field.sizeY)
+                   && z < static_cast<int64_t>(m_field.sizeZ);
+        }
+
+        void put(size_t x, size_t y, size_t z, const uint32_t* color)
+        {
+            const size_t idx = m_field.index(x, y, z);
+            m_field.alive[idx] = 1;
+            if (color)
+                m_field.colors[idx] = *color;
+            m_field.markCellChanged(x, y, z);
+            ++m_result.placed;
+        }
+
+        FieldComponent& m_field;
+        glm::ivec3 m_offset;
+        PlaceResult m_result;
+    };
+
+    /**
+     * Read file by big blocks, char by char
+     */
+    class BlockReader
+    {
+    public:
+        explicit BlockReader(const std::string& file) :
+                m_in(open_file(file)), m_buffer(read_block_size), m_pos(0),
+                m_size(0)
+        {}
+
+        /**
+         * @return next char or -1 at the end of file
+         */
+        int get()
+        {
+            if (m_pos == m_size) {
+                m_in.read(m_buffer.data(), m_buffer.size());
+                m_size = m_in.gcount();
+                m_pos = 0;
+                if (m_size == 0)
+                    return -1;
+            }
+
+            return static_cast<unsigned char>(m_buffer[m_pos++]);
+        }
+
+        void skipLine()
+        {
+            int c;
+            while ((c = get()) != -1 && c != '\n')
+                ;
+        }
+
+    private:
+        std::ifstream m_in;
+        std::vector<char> m_buffer;
+        size_t m_pos;
+        size_t m_size;
+    };
+
+    void place_rle(const std::string& file, Placer& placer)
+    {
+        BlockReader reader(file);
+        int64_t x = 0, y = 0, z = 0, count = 0;
+        bool lineStart = true, body = false;
+        for (int c = reader.get(); c != -1 && c != '!'; c = reader.get()) {
+            // Comments and "x = 1, y = 1, z = 1, rule = ..." header
+            if (lineStart && !body && (c == '#' || c == 'x')) {
+                reader.skipLine();
+                continue;
+            }
+
+            lineStart = c == '\n';
+            if (std::isspace(c))
+                continue;
+
+            body = true;
+            if (std::isdigit(c)) {
+                count = count * 10 + (c - '0');
+                if (count > max_pattern_position)
+                    throw_broken(file, "too big rle count");
+                continue;
+            }
+
+            const int64_t n = count ? count : 1;
+            count = 0;
+            if (c == '$') {
+                y += n;
+                x = 0;
+            } else if (c == '/') {
+                z += n;
+                y = 0;
+                x = 0;
+            } else if (c == 'b' || c == '.') {
+                x += n;
+            } else if (std::isalpha(c)) {
+                // Any other state is alive
+                placer.setRun(x, y, z, n);
+                x += n;
+            } else {
+                throw_broken(file, "unknown rle token");
+            }
+            if (x > max_pattern_position || y > max_pattern_position
+                || z > max_pattern_position)
+                throw_broken(file, "too big rle pattern");
+        }
+    }
+
+    void place_coordinates(const std::string& file, Placer& placer)
+    {
+        std::ifstream in = open_file(file);
+        std::string line;
+        while (std::getline(in, line)) {
+            const char* ptr = line.data();
+            const char* end = ptr + line.size();
+            int64_t coords[3];
+            size_t found = 0;
+            while (found < 3 && ptr != end) {
+                if (*ptr == '#')
+                    break;
+                if (std::isspace(static_cast<unsigned char>(*ptr))
+                    || *ptr == ',' || *ptr == ';') {
+                    ++ptr;
+                    continue;
+                }
+
+                auto [next, err] = std::from_chars(ptr, end, coords[found]);
+                if (err != std::errc())
+                    throw_broken(file, "wrong coordinate");
+                if (coords[found] > max_pattern_position
+                    || coords[found] < -max_pattern_position)
+                    throw_broken(file, "too big coordinate");
+                ptr = next;
+                ++found;
+            }
+
+            if (found == 3)
+                placer.set(coords[0], coords[1], coords[2]);
+            else if (found != 0)
+                throw_broken(file, "line without 3 coordinates");
+        }
+    }
+
+    struct VoxChunk
+    {
+        char id[4];
+        int32_t contentSize;
+        int32_t childrenSize;
+    };
+
+    bool read_vox_chunk(std::ifstream& in, VoxChunk& chunk)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&chunk),
+                                         sizeof(chunk)));
+    }
+
+    /**
+     * Check that chunk which header was just read ends before end,
+     * so skipping it always moves forward
+     * @param file
+     * @param in
+     * @param chunk
+     * @param end
+     */
+    void check_vox_chunk(const std::string& file, std::ifstream& in,
+                         const VoxChunk& chunk, std::streampos end)
+    {
+        if (chunk.contentSize < 0 || chunk.childrenSize < 0
+            || in.tellg() + std::streamoff(chunk.contentSize)
+               + std::streamoff(chunk.childrenSize) > end)
+            throw_broken(file, "wrong chunk size");
+    }
+
+    void place_vox(const std::string& file, Placer& placer)
+    {
+        std::ifstream in = open_file(file);
+        in.seekg(0, std::ios::end);
+        const std::streampos fileEnd = in.tellg();
+        in.seekg(0);
+
+        char magic[4];
+        int32_t version;
+        VoxChunk main{};
+        if (!in.read(magic, sizeof(magic))
+            || std::memcmp(magic, "VOX ", sizeof(magic)) != 0
+            || !in.read(reinterpret_cast<char*>(&version), sizeof(version))
+            || !read_vox_chunk(in, main)
+            || std::memcmp(main.id, "MAIN", sizeof(main.id)) != 0)
+            throw_broken(file, "not a vox file");
+        check_vox_chunk(file, in, main, fileEnd);
+
+        in.seekg(main.contentSize, std::ios::cur);
+        const std::streampos childrenBegin = in.tellg();
+        const std::streampos childrenEnd = childrenBegin
+                                           + std::streamoff(main.childrenSize);
+
+        // Palette goes after models, so it is found before placing.
+        // Without palette cells keep their colors
+        std::array<uint32_t, 256> palette{};
+        bool hasPalette = false;
+        VoxChunk chunk{};
+        while (in.tellg() < childrenEnd && read_vox_chunk(in, chunk)) {
+            check_vox_chunk(file, in, chunk, childrenEnd);
+            if (std::memcmp(chunk.id, "RGBA", sizeof(chunk.id)) == 0
+                && chunk.contentSize >= static_cast<int32_t>(sizeof(palette))) {
+                in.read(reinterpret_cast<char*>(palette.data()),
+                        sizeof(palette));
+                in.seekg(std::streamoff(chunk.contentSize) - sizeof(palette)
+                         + chunk.childrenSize, std::ios::cur);
+                hasPalette = true;
+            } else {
+                in.seekg(std::streamoff(chunk.contentSize)
+                         + chunk.childrenSize, std::ios::cur);
+            }
+        }
+
+        in.clear();
+        in.seekg(childrenBegin);
+        std::vector<std::array<uint8_t, 4>> voxels(voxels_block_size);
+        while (in.tellg() < childrenEnd && read_vox_chunk(in, chunk)) {
+            check_vox_chunk(file, in, chunk, childrenEnd);
+            if (std::memcmp(chunk.id, "XYZI", sizeof(chunk.id)) != 0) {
+                in.seekg(std::streamoff(chunk.contentSize)
+                         + chunk.childrenSize, std::ios::cur);
+                continue;
+            }
+
+            int32_t count;
+            if (!in.read(reinterpret_cast<char*>(&count), sizeof(count))
+                || count < 0 || chunk.contentSize < 4 + 4 * int64_t(count))
+                throw_broken(file, "wrong voxels chunk");
+
+            for (int32_t done = 0; done < count;) {
+                const size_t n = std::min<size_t>(voxels.size(), count - done);
+                if (!in.read(reinterpret_cast<char*>(voxels.data()), n * 4))
+                    throw_broken(file, "truncated voxels chunk");
+
+                // Color index 0 is empty, palette entry i is color i + 1
+                for (size_t i = 0; i < n; ++i) {
+                    const auto& [x, y, z, color] = voxels[i];
+                    placer.set(x, y, z,
+                               hasPalette ? &palette[(color + 255) % 256]
+                                          : nullptr);
+                }
+                done += n;
+            }
+
+            in.seekg(chunk.contentSize - 4 - 4 * int64_t(count)
+                     + chunk.childrenSize, std::ios::cur);
+        }
+    }
+}
+
+namespace utils::pattern
+{
+    PatternFormat detectFormat(const std::string& file)
+    {
+        const size_t dot = file.rfind('.');
+        const std::string ext = dot == std::string::npos
+                                ? "" : boost::to_lower_copy(file.substr(dot));
+        if (ext == ".rle")
+            return PatternFormat::RLE;
+        if (ext == ".vox")
+            return PatternFormat::VOX;
+
+        return PatternFormat::COORDINATES;
+    }
+
+    PlaceResult place(const std::string& file, FieldComponent& field,
+                      const glm::ivec3& offset)
+    {
+        Placer placer(field, offset);
+        switch (detectFormat(file)) {
+            case PatternFormat::RLE:
+                place_rle(file, placer);
+                break;
+            case PatternFormat::VOX:
+                place_vox(file, placer);
+                break;
+            case PatternFormat::COORDINATES:
+                place_coordinates(file, placer);
+                break;
+        }
+
+        return placer.getResult();
+    }
+}
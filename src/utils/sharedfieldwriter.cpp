@@ -0,0 +1,130 @@
+#include <cerrno>
+#include <cstring>
+#include <boost/format.hpp>
+
+#include "utils/sharedfieldwriter.hpp"
+#include "utils/logger.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace
+{
+    // Slots and planes start at cache lines
+    const size_t alignment = 64;
+
+    size_t align_up(size_t val)
+    {
+        return (val + alignment - 1) / alignment * alignment;
+    }
+}
+
+namespace utils::sharedfield
+{
+    SharedFieldWriter::SharedFieldWriter(std::string name) :
+            m_name(std::move(name)), m_data(nullptr), m_size(0)
+    {}
+
+    SharedFieldWriter::~SharedFieldWriter()
+    {
+        remove();
+    }
+
+    void SharedFieldWriter::publish(const FieldComponent& field)
+    {
+        if (!m_data || header().sizeX != field.sizeX
+            || header().sizeY != field.sizeY || header().sizeZ != field.sizeZ)
+            create(field);
+
+        SharedFieldHeader& h = header();
+        const size_t idx = (h.latest.load(std::memory_order_relaxed) + 1)
+                           % slots_count;
+        uint8_t* base = m_data + h.slotOffsets[idx];
+        auto& slot = *reinterpret_cast<SlotHeader*>(base);
+
+        // Readers of this slot see odd sequence or changed one after reading
+        const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::memcpy(base + h.aliveOffset, field.alive.data(), field.size());
+        std::memcpy(base + h.colorsOffset, field.colors.data(),
+                    field.size() * sizeof(uint32_t));
+        slot.generation = field.generation;
+
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        h.latest.store(idx, std::memory_order_release);
+    }
+
+    void SharedFieldWriter::create(const FieldComponent& field)
+    {
+        remove();
+
+        const size_t cells = field.size();
+        const size_t aliveOffset = align_up(sizeof(SlotHeader));
+        const size_t colorsOffset = align_up(aliveOffset + cells);
+        const size_t slotSize = align_up(colorsOffset
+                                         + cells * sizeof(uint32_t));
+        const size_t firstSlot = align_up(sizeof(SharedFieldHeader));
+        const size_t size = firstSlot + slots_count * slotSize;
+
+        // Segment left by crashed run may be mapped by readers, truncating
+        // it would crash them, so it is unlinked and new one is created
+        shm_unlink(m_name.c_str());
+        int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd == -1)
+            throw FSException((format("Can't create shared memory %s: %s\n")
+                               % m_name % std::strerror(errno)).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        void* data = MAP_FAILED;
+        if (ftruncate(fd, size) == 0)
+            data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            shm_unlink(m_name.c_str());
+            throw FSException((format("Can't map shared memory %s: %s\n")
+                               % m_name % std::strerror(errno)).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+        }
+
+        m_data = static_cast<uint8_t*>(data);
+        m_size = size;
+
+        // New segment is zeroed, so sequences and flags start from 0
+        SharedFieldHeader& h = header();
+        h.version = shared_version;
+        h.headerSize = sizeof(SharedFieldHeader);
+        h.sizeX = field.sizeX;
+        h.sizeY = field.sizeY;
+        h.sizeZ = field.sizeZ;
+        for (size_t i = 0; i < slots_count; ++i)
+            h.slotOffsets[i] = firstSlot + i * slotSize;
+        h.aliveOffset = aliveOffset;
+        h.colorsOffset = colorsOffset;
+        // Readers accept segment with magic only
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(h.magic, shared_magic, sizeof(shared_magic));
+    }
+
+    void SharedFieldWriter::remove()
+    {
+        if (!m_data)
+            return;
+
+        // Readers keep their mapping of removed segment
+        header().stale.store(1, std::memory_order_release);
+        munmap(m_data, m_size);
+        shm_unlink(m_name.c_str());
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    SharedFieldHeader& SharedFieldWriter::header()
+    {
+        return *reinterpret_cast<SharedFieldHeader*>(m_data);
+    }
+}
@@ -0,0 +1,1055 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <boost/format.hpp>
+
+#include "utils/snapshot.hpp"
+#include "utils/logger.hpp"
+#include "utils/filemapping.hpp"
+#include "utils/asyncwriter.hpp"
+#include "utils/checksum.hpp"
+#include "exceptions/fsexception.hpp"
+
+using boost::format;
+using utils::log::program_log_file_name;
+using utils::log::Category;
+
+namespace
+{
+    const char snapshot_magic[8] = {'L', 'I', 'F', 'E', 'S', 'N', 'A', 'P'};
+    // Only neighbourhood of 6 faces and 8 corners is simulated now
+    const uint32_t neighbours_count = 14;
+    const uint32_t colors_flag = 1;
+    const size_t plane_alignment = 64;
+    // Larger fields are refused as broken files
+    const uint64_t max_side = 1 << 16;
+    const uint64_t max_cells = uint64_t(1) << 36;
+    // Version 1 header ends before chunk index fields,
+    // version 2 header ends before checksums
+    const uint32_t header_v1_size = 104;
+    const uint32_t header_v2_size = 128;
+    // Bytes of alive plane covered by one checksum
+    const uint32_t checksum_block = 64 << 10;
+    const size_t chunk_size = FieldComponent::chunk_size;
+    const uint32_t white = 0xFFFFFFFFu;
+
+    /**
+     * Snapshot file starts with this header, offsets are from file start
+     */
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t sizeX;
+        uint64_t sizeY;
+        uint64_t sizeZ;
+        uint64_t generation;
+        uint32_t neirCount;
+        uint32_t neirCountDie;
+        uint32_t neighbours;
+        uint32_t boundary;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t aliveOffset;
+        uint64_t aliveSize;
+        uint64_t colorsOffset;
+        uint64_t colorsSize;
+        // Chunk index is optional, its size is zero without it
+        uint32_t chunkSize;
+        uint32_t reserved2;
+        uint64_t indexOffset;
+        uint64_t indexSize;
+        // Bytes of alive plane per CRC32C, zero without checksums
+        uint32_t checksumBlock;
+        // CRC32C of header with this field set to zero
+        uint32_t headerChecksum;
+        uint64_t checksumsOffset;
+        uint64_t checksumsSize;
+        uint64_t reserved3;
+    };
+
+    /**
+     * Entry of chunk index, chunks go in FieldComponent order
+     */
+    struct ChunkEntry
+    {
+        // Colors of live cells of chunk from file start, 0 without colors
+        uint64_t colorsOffset;
+        uint32_t population;
+        // Bounding box of live cells inside chunk, inclusive
+        uint8_t min[3];
+        uint8_t max[3];
+        uint16_t reserved;
+        // CRC32C of colors of chunk continued by entry with this field
+        // set to zero, set only if header has checksums
+        uint32_t checksum;
+    };
+
+    static_assert(sizeof(SnapshotHeader) == 160);
+    static_assert(sizeof(ChunkEntry) == 24);
+    static_assert(std::endian::native == std::endian::little,
+                  "Snapshot planes are written in host byte order");
+
+    size_t align_up(size_t val)
+    {
+        return (val + plane_alignment - 1) / plane_alignment * plane_alignment;
+    }
+
+    uint64_t chunks_of(uint64_t size)
+    {
+        return (size + chunk_size - 1) / chunk_size;
+    }
+
+    uint64_t blocks_of(uint64_t aliveSize)
+    {
+        return (aliveSize + checksum_block - 1) / checksum_block;
+    }
+
+    uint32_t header_checksum(SnapshotHeader header)
+    {
+        header.headerChecksum = 0;
+        return utils::checksum::crc32c(&header, sizeof(header));
+    }
+
+    /**
+     * @param entry
+     * @param colorsChecksum CRC32C of colors of chunk
+     * @return checksum of index entry
+     */
+    uint32_t entry_checksum(ChunkEntry entry, uint32_t colorsChecksum)
+    {
+        entry.checksum = 0;
+        return utils::checksum::crc32c(&entry, sizeof(entry), colorsChecksum);
+    }
+
+    /**
+     * Cells from begin (inclusive) to end (exclusive)
+     */
+    struct Box
+    {
+        uint64_t begin[3];
+        uint64_t end[3];
+    };
+
+    /**
+     * Pack 8 cells to byte, first cell goes to lowest bit
+     * @param cells
+     * @return
+     */
+    uint8_t pack_cells(const uint8_t* cells)
+    {
+        uint64_t t;
+        std::memcpy(&t, cells, sizeof(t));
+        // Any non zero byte becomes 1, bits never cross bytes
+        // before the lowest bit of each byte is taken
+        t |= t >> 4;
+        t |= t >> 2;
+        t |= t >> 1;
+        t &= 0x0101010101010101ull;
+
+        // Moves lowest bit of byte i to bit 56 + i
+        return static_cast<uint8_t>((t * 0x0102040810204080ull) >> 56);
+    }
+
+    /**
+     * Byte of alive plane to 8 cells
+     */
+    constexpr std::array<uint64_t, 256> unpack_table = [] {
+        std::array<uint64_t, 256> table{};
+        for (size_t byte = 0; byte < 256; ++byte)
+            for (size_t bit = 0; bit < 8; ++bit)
+                if (byte & (1 << bit))
+                    table[byte] |= uint64_t(1) << (bit * 8);
+
+        return table;
+    }();
+
+    [[noreturn]] void throw_broken(const std::string& file,
+                                   const std::string& reason)
+    {
+        throw FSException((format("Broken snapshot %s: %s\n")
+                           % file % reason).str(),
+                          program_log_file_name(), Category::FILE_ERROR);
+    }
+
+    /**
+     * Check header and bounds of planes in mapping of snapshot file
+     * @param file
+     * @param mapping
+     * @return
+     */
+    SnapshotHeader read_header(const std::string& file,
+                               const utils::FileMapping& mapping)
+    {
+        using utils::snapshot::Boundary;
+        using utils::snapshot::snapshot_version;
+
+        if (mapping.size() < header_v1_size)
+            throw_broken(file, "file is too small");
+
+        SnapshotHeader header{};
+        std::memcpy(&header, mapping.data(), header_v1_size);
+        if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)))
+            throw_broken(file, "wrong magic");
+        // Older versions are the same without chunk index or checksums
+        const uint32_t headerSize = header.version == 1 ? header_v1_size
+                                    : header.version == 2 ? header_v2_size
+                                    : header.version == snapshot_version
+                                      ? sizeof(header) : 0;
+        if (headerSize == 0 || header.headerSize != headerSize)
+            throw_broken(file, "unsupported version");
+        if (mapping.size() < headerSize)
+            throw_broken(file, "file is too small");
+        std::memcpy(&header, mapping.data(), headerSize);
+        if (header.version == snapshot_version
+            && header.headerChecksum != header_checksum(header))
+            throw_broken(file, "header checksum mismatch");
+        if (header.neighbours != neighbours_count
+            || header.boundary != static_cast<uint32_t>(Boundary::DEAD))
+            throw_broken(file, "unsupported rule");
+        if (header.sizeX > max_side || header.sizeY > max_side
+            || header.sizeZ > max_side
+            || header.sizeX * header.sizeY * header.sizeZ > max_cells)
+            throw_broken(file, "field is too large");
+
+        const size_t cells = header.sizeX * header.sizeY * header.sizeZ;
+        if (header.aliveSize != (cells + 7) / 8
+            || header.aliveOffset > mapping.size()
+            || header.aliveSize > mapping.size() - header.aliveOffset)
+            throw_broken(file, "wrong alive plane");
+
+        const uint64_t chunks = chunks_of(header.sizeX)
+                                * chunks_of(header.sizeY)
+                                * chunks_of(header.sizeZ);
+        if (header.indexSize != 0
+            && (header.chunkSize != chunk_size
+                || header.indexSize != chunks * sizeof(ChunkEntry)
+                || header.indexOffset % alignof(ChunkEntry)
+                || header.indexOffset > mapping.size()
+                || header.indexSize > mapping.size() - header.indexOffset))
+            throw_broken(file, "wrong chunk index");
+
+        if ((header.flags & colors_flag)
+            && (header.colorsSize % sizeof(uint16_t)
+                || header.colorsOffset > mapping.size()
+                || header.colorsSize > mapping.size() - header.colorsOffset))
+            throw_broken(file, "wrong color plane");
+
+        if (header.checksumBlock != 0
+            && (header.checksumBlock != checksum_block
+                || header.checksumsSize
+                   != blocks_of(header.aliveSize) * sizeof(uint32_t)
+                || header.checksumsOffset % alignof(uint32_t)
+                || header.checksumsOffset > mapping.size()
+                || header.checksumsSize
+                   > mapping.size() - header.checksumsOffset))
+            throw_broken(file, "wrong checksums");
+
+        return header;
+    }
+
+    utils::snapshot::SnapshotInfo info_of(const SnapshotHeader& header)
+    {
+        return {header.neirCount, header.neirCountDie,
+                static_cast<utils::snapshot::Boundary>(header.boundary),
+                (header.flags & colors_flag) != 0};
+    }
+
+    utils::snapshot::SnapshotLayout layout_of(const SnapshotHeader& header)
+    {
+        return {header.sizeX, header.sizeY, header.sizeZ, header.generation,
+                info_of(header), header.aliveOffset, header.aliveSize,
+                header.checksumBlock, header.checksumsOffset};
+    }
+
+    bool chunk_intersects(uint64_t idx, uint64_t chunksY, uint64_t chunksZ,
+                          const Box& box)
+    {
+        const uint64_t origin[3] = {idx / chunksZ / chunksY * chunk_size,
+                                    idx / chunksZ % chunksY * chunk_size,
+                                    idx % chunksZ * chunk_size};
+        for (size_t i = 0; i < 3; ++i)
+            if (origin[i] >= box.end[i]
+                || origin[i] + chunk_size <= box.begin[i])
+                return false;
+
+        return true;
+    }
+
+    /**
+     * Compare CRC32C of alive plane blocks with checksums of file.
+     * FSException names the first broken block and planes it covers.
+     * @param file
+     * @param data mapping of file
+     * @param layout
+     * @param blocks indices of blocks to check
+     * @param pool
+     */
+    void check_blocks(const std::string& file, const uint8_t* data,
+                      const utils::snapshot::SnapshotLayout& layout,
+                      const std::vector<uint64_t>& blocks, ThreadPool* pool)
+    {
+        using utils::checksum::crc32c;
+
+        const uint8_t* bits = data + layout.aliveOffset;
+        const uint8_t* checksums = data + layout.checksumsOffset;
+        auto broken = utils::checksum::findBroken(blocks.size(), [&](size_t i) {
+            const uint64_t begin = blocks[i] * checksum_block;
+            const uint64_t size = std::min<uint64_t>(checksum_block,
+                                                     layout.aliveSize - begin);
+            uint32_t checksum;
+            std::memcpy(&checksum, checksums + blocks[i] * sizeof(checksum),
+                        sizeof(checksum));
+            return crc32c(bits + begin, size) == checksum;
+        }, pool);
+        if (broken.empty())
+            return;
+
+        const uint64_t block = blocks[broken.front()];
+        const uint64_t cells = layout.sizeX * layout.sizeY * layout.sizeZ;
+        const uint64_t planeCells = layout.sizeY * layout.sizeZ;
+        const uint64_t first = block * checksum_block * 8;
+        const uint64_t last = std::min(cells, first + checksum_block * 8) - 1;
+        throw_broken(file, (format("checksum mismatch in alive block %d "
+                                   "of planes x %d..%d (%d broken)")
+                            % block % (first / planeCells)
+                            % (last / planeCells) % broken.size()).str());
+    }
+
+    /**
+     * Check index of chunks which intersect box. Checksum of each such
+     * entry and its colors is compared first if file has checksums, then
+     * entry has to lie in its chunk and its colors in color plane.
+     * Entries without live cells are checked always, so chunk can't be
+     * lost by broken population.
+     * @param file
+     * @param header
+     * @param mapping
+     * @param box
+     * @param pool checksums are compared in parallel
+     */
+    void check_index(const std::string& file, const SnapshotHeader& header,
+                     const utils::FileMapping& mapping, const Box& box,
+                     ThreadPool* pool)
+    {
+        const uint64_t chunksY = chunks_of(header.sizeY);
+        const uint64_t chunksZ = chunks_of(header.sizeZ);
+        const uint64_t sizes[3] = {header.sizeX, header.sizeY, header.sizeZ};
+        const bool hasColors = header.flags & colors_flag;
+        const uint8_t* index = mapping.data() + header.indexOffset;
+        const uint64_t chunks = header.indexSize / sizeof(ChunkEntry);
+        auto entry_at = [index](uint64_t idx) {
+            ChunkEntry entry{};
+            std::memcpy(&entry, index + idx * sizeof(entry), sizeof(entry));
+            return entry;
+        };
+
+        if (header.checksumBlock != 0) {
+            auto broken = utils::checksum::findBroken(chunks, [&](size_t idx) {
+                const ChunkEntry entry = entry_at(idx);
+                if (entry.population != 0
+                    && !chunk_intersects(idx, chunksY, chunksZ, box))
+                    return true;
+
+                uint32_t colorsChecksum = 0;
+                if (hasColors && entry.population != 0) {
+                    const uint64_t size = entry.population * sizeof(uint16_t);
+                    const uint64_t end = header.colorsOffset
+                                         + header.colorsSize;
+                    if (entry.colorsOffset < header.colorsOffset
+                        || entry.colorsOffset > end
+                        || size > end - entry.colorsOffset)
+                        return false;
+                    colorsChecksum = utils::checksum::crc32c(
+                            mapping.data() + entry.colorsOffset, size);
+                }
+
+                return entry_checksum(entry, colorsChecksum) == entry.checksum;
+            }, pool);
+
+            if (!broken.empty()) {
+                const uint64_t idx = broken.front();
+                throw_broken(file, (format("checksum mismatch in chunk at "
+                                           "%d,%d,%d (%d broken)")
+                                    % (idx / chunksZ / chunksY * chunk_size)
+                                    % (idx / chunksZ % chunksY * chunk_size)
+                                    % (idx % chunksZ * chunk_size)
+                                    % broken.size()).str());
+            }
+        }
+
+        uint64_t aliveCount = 0;
+        for (uint64_t idx = 0; idx < chunks; ++idx) {
+            const ChunkEntry entry = entry_at(idx);
+            if (entry.population == 0)
+                continue;
+
+            const uint64_t origin[3] = {idx / chunksZ / chunksY * chunk_size,
+                                        idx / chunksZ % chunksY * chunk_size,
+                                        idx % chunksZ * chunk_size};
+            // Bounds are within chunk, decoding reads rows of chunk size
+            for (size_t i = 0; i < 3; ++i)
+                if (entry.min[i] > entry.max[i] || entry.max[i] >= chunk_size
+                    || origin[i] + entry.max[i] >= sizes[i])
+                    throw_broken(file, "wrong chunk index");
+
+            const uint64_t colorsSize = entry.population * sizeof(uint16_t);
+            if (hasColors
+                && (entry.colorsOffset < header.colorsOffset
+                    || entry.colorsOffset - header.colorsOffset
+                       > header.colorsSize
+                    || colorsSize > header.colorsSize
+                                    - (entry.colorsOffset
+                                       - header.colorsOffset)))
+                throw_broken(file, "wrong chunk colors");
+            aliveCount += entry.population;
+        }
+
+        if (hasColors && header.colorsSize != aliveCount * sizeof(uint16_t))
+            throw_broken(file, "wrong color plane");
+    }
+
+    /**
+     * Check checksums of alive plane blocks read by decoding of box,
+     * that is blocks with rows of bounding boxes of chunks in box.
+     * Index has to be checked already.
+     * @param file
+     * @param header
+     * @param mapping
+     * @param box
+     * @param pool
+     */
+    void check_alive(const std::string& file, const SnapshotHeader& header,
+                     const utils::FileMapping& mapping, const Box& box,
+                     ThreadPool* pool)
+    {
+        if (header.checksumBlock == 0)
+            return;
+
+        const uint64_t chunksY = chunks_of(header.sizeY);
+        const uint64_t chunksZ = chunks_of(header.sizeZ);
+        const uint64_t blockCells = uint64_t(checksum_block) * 8;
+        const uint8_t* index = mapping.data() + header.indexOffset;
+        std::vector<uint8_t> needed(blocks_of(header.aliveSize));
+        for (uint64_t idx = 0; idx < header.indexSize / sizeof(ChunkEntry);
+             ++idx) {
+            ChunkEntry entry{};
+            std::memcpy(&entry, index + idx * sizeof(entry), sizeof(entry));
+            if (entry.population == 0
+                || !chunk_intersects(idx, chunksY, chunksZ, box))
+                continue;
+
+            const uint64_t x0 = idx / chunksZ / chunksY * chunk_size;
+            const uint64_t y0 = idx / chunksZ % chunksY * chunk_size;
+            const uint64_t z0 = idx % chunksZ * chunk_size;
+            for (uint64_t x = x0 + entry.min[0]; x <= x0 + entry.max[0]; ++x)
+                for (uint64_t y = y0 + entry.min[1]; y <= y0 + entry.max[1];
+                     ++y) {
+                    const uint64_t row = (x * header.sizeY + y) * header.sizeZ;
+                    const uint64_t first = row + z0 + entry.min[2];
+                    const uint64_t last = row + z0 + entry.max[2];
+                    for (uint64_t b = first / blockCells; b <= last / blockCells;
+                         ++b)
+                        needed[b] = 1;
+                }
+        }
+
+        std::vector<uint64_t> blocks;
+        for (uint64_t b = 0; b < needed.size(); ++b)
+            if (needed[b])
+                blocks.push_back(b);
+        check_blocks(file, mapping.data(), layout_of(header), blocks, pool);
+    }
+
+    /**
+     * Decode live cells of indexed chunks which intersect box.
+     * Cells of box are put to field starting from its origin,
+     * chunks without live cells aren't touched at all.
+     * @param file
+     * @param header
+     * @param mapping
+     * @param box
+     * @param field dead field with size of box
+     */
+    void decode_chunks(const std::string& file, const SnapshotHeader& header,
+                       const utils::FileMapping& mapping, const Box& box,
+                       FieldComponent& field)
+    {
+        using utils::snapshot::from_rgb565;
+
+        const uint64_t chunksY = chunks_of(header.sizeY);
+        const uint64_t chunksZ = chunks_of(header.sizeZ);
+        const bool hasColors = header.flags & colors_flag;
+        const uint8_t* bits = mapping.data() + header.aliveOffset;
+        const uint8_t* index = mapping.data() + header.indexOffset;
+        uint8_t row[chunk_size];
+        for (uint64_t idx = 0; idx < header.indexSize / sizeof(ChunkEntry);
+             ++idx) {
+            ChunkEntry entry{};
+            std::memcpy(&entry, index + idx * sizeof(entry), sizeof(entry));
+            if (entry.population == 0)
+                continue;
+
+            const uint64_t origin[3] = {idx / chunksZ / chunksY * chunk_size,
+                                        idx / chunksZ % chunksY * chunk_size,
+                                        idx % chunksZ * chunk_size};
+            Box live{};
+            bool intersects = true;
+            for (size_t i = 0; i < 3; ++i) {
+                live.begin[i] = origin[i] + entry.min[i];
+                live.end[i] = origin[i] + entry.max[i] + 1;
+                intersects &= live.begin[i] < box.end[i]
+                              && live.end[i] > box.begin[i];
+            }
+            if (!intersects)
+                continue;
+
+            // Colors go in order of live cells of bounding box
+            const uint8_t* colors = mapping.data() + entry.colorsOffset;
+            uint64_t found = 0;
+            for (uint64_t x = live.begin[0]; x < live.end[0]; ++x) {
+                for (uint64_t y = live.begin[1]; y < live.end[1]; ++y) {
+                    const uint64_t count = live.end[2] - live.begin[2];
+                    if (count > chunk_size)
+                        throw_broken(file, "wrong chunk index");
+                    utils::snapshot::unpack_bits(
+                            bits, (x * header.sizeY + y) * header.sizeZ
+                                  + live.begin[2], count, row);
+                    for (uint64_t z = live.begin[2]; z < live.end[2]; ++z) {
+                        if (!row[z - live.begin[2]])
+                            continue;
+                        if (found == entry.population)
+                            throw_broken(file, "chunk population mismatch");
+
+                        const uint64_t colorIdx = found++;
+                        if (x < box.begin[0] || x >= box.end[0]
+                            || y < box.begin[1] || y >= box.end[1]
+                            || z < box.begin[2] || z >= box.end[2])
+                            continue;
+
+                        const size_t cell = field.index(x - box.begin[0],
+                                                        y - box.begin[1],
+                                                        z - box.begin[2]);
+                        field.alive[cell] = 1;
+                        if (hasColors) {
+                            uint16_t color;
+                            std::memcpy(&color, colors + colorIdx
+                                                         * sizeof(color),
+                                        sizeof(color));
+                            field.colors[cell] = from_rgb565(color);
+                        } else {
+                            field.colors[cell] = white;
+                        }
+                    }
+                }
+            }
+
+            if (found != entry.population)
+                throw_broken(file, "chunk population mismatch");
+        }
+    }
+
+    /**
+     * Decode the whole alive plane of snapshot without chunk index
+     * @param file
+     * @param header
+     * @param mapping
+     * @param field
+     * @param pool checksums of blocks are compared in parallel
+     */
+    void decode_plane(const std::string& file, const SnapshotHeader& header,
+                      const utils::FileMapping& mapping, FieldComponent& field,
+                      ThreadPool* pool)
+    {
+        using utils::snapshot::from_rgb565;
+
+        const size_t cells = header.sizeX * header.sizeY * header.sizeZ;
+        const bool hasColors = header.flags & colors_flag;
+        const uint8_t* bits = mapping.data() + header.aliveOffset;
+        if (header.checksumBlock != 0) {
+            std::vector<uint64_t> blocks(blocks_of(header.aliveSize));
+            for (uint64_t b = 0; b < blocks.size(); ++b)
+                blocks[b] = b;
+            check_blocks(file, mapping.data(), layout_of(header), blocks, pool);
+        }
+
+        size_t aliveCount = 0;
+        for (size_t i = 0; i < header.aliveSize; ++i)
+            aliveCount += std::popcount(bits[i]);
+        // Bits after last cell are always zero
+        if (cells % 8 && bits[header.aliveSize - 1] >> (cells % 8))
+            throw_broken(file, "wrong alive plane");
+
+        if (hasColors && header.colorsSize != aliveCount * sizeof(uint16_t))
+            throw_broken(file, "wrong color plane");
+
+        field.resize(header.sizeX, header.sizeY, header.sizeZ);
+        field.generation = header.generation;
+
+        utils::snapshot::unpack_alive(bits, cells, field.alive.data());
+
+        // Colors go in order of live cells
+        const uint8_t* colors = mapping.data() + header.colorsOffset;
+        size_t colorIdx = 0;
+        for (size_t byte = 0; byte < header.aliveSize; ++byte) {
+            for (uint8_t b = bits[byte]; b; b &= b - 1) {
+                const size_t idx = byte * 8 + std::countr_zero(b);
+                if (hasColors) {
+                    uint16_t color;
+                    std::memcpy(&color, colors + colorIdx * sizeof(color),
+                                sizeof(color));
+                    field.colors[idx] = from_rgb565(color);
+                    ++colorIdx;
+                } else {
+                    field.colors[idx] = white;
+                }
+            }
+        }
+    }
+}
+
+namespace utils::snapshot
+{
+    size_t pack_alive(const uint8_t* cells, size_t count, uint8_t* bits)
+    {
+        size_t i = 0, byte = 0, aliveCount = 0;
+        for (; i + 8 <= count; i += 8) {
+            bits[byte] = pack_cells(cells + i);
+            aliveCount += std::popcount(bits[byte++]);
+        }
+
+        if (i < count) {
+            uint8_t tail = 0;
+            for (size_t bit = 0; i < count; ++i, ++bit)
+                tail |= (cells[i] != 0) << bit;
+            bits[byte] = tail;
+            aliveCount += std::popcount(tail);
+        }
+
+        return aliveCount;
+    }
+
+    void unpack_alive(const uint8_t* bits, size_t count, uint8_t* cells)
+    {
+        size_t byte = 0;
+        for (; byte < count / 8; ++byte)
+            std::memcpy(cells + byte * 8, &unpack_table[bits[byte]],
+                        sizeof(uint64_t));
+        for (size_t i = byte * 8; i < count; ++i)
+            cells[i] = bits[byte] >> (i % 8) & 1;
+    }
+
+    void unpack_bits(const uint8_t* bits, size_t offset, size_t count,
+                     uint8_t* cells)
+    {
+        if (offset % 8 == 0) {
+            unpack_alive(bits + offset / 8, count, cells);
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i, ++offset)
+            cells[i] = bits[offset / 8] >> (offset % 8) & 1;
+    }
+
+    uint16_t to_rgb565(uint32_t color)
+    {
+        uint32_t r = color & 0xFF, g = color >> 8 & 0xFF, b = color >> 16 & 0xFF;
+        return static_cast<uint16_t>((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+    }
+
+    uint32_t from_rgb565(uint16_t color)
+    {
+        uint32_t r = color >> 11 & 0x1F, g = color >> 5 & 0x3F, b = color & 0x1F;
+        r = r << 3 | r >> 2;
+        g = g << 2 | g >> 4;
+        b = b << 3 | b >> 2;
+
+        return r | g << 8 | b << 16 | 0xFFu << 24;
+    }
+
+    void save(const std::string& file, const FieldComponent& field,
+              const SnapshotInfo& info, bool directIo)
+    {
+        const size_t cells = field.size();
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+        header.version = snapshot_version;
+        header.headerSize = sizeof(header);
+        header.sizeX = field.sizeX;
+        header.sizeY = field.sizeY;
+        header.sizeZ = field.sizeZ;
+        header.generation = field.generation;
+        header.neirCount = info.neirCount;
+        header.neirCountDie = info.neirCountDie;
+        header.neighbours = neighbours_count;
+        header.boundary = static_cast<uint32_t>(info.boundary);
+        header.flags = info.hasColors ? colors_flag : 0;
+        header.aliveOffset = align_up(sizeof(header));
+        header.aliveSize = (cells + 7) / 8;
+
+        // Chunk index is gathered first, so header is written only once.
+        // Field copies may have no chunk grid, it is computed from sizes
+        const uint64_t chunksY = chunks_of(field.sizeY);
+        const uint64_t chunksZ = chunks_of(field.sizeZ);
+        std::vector<ChunkEntry> index(chunks_of(field.sizeX) * chunksY
+                                      * chunksZ);
+        static const uint8_t dead[chunk_size] = {};
+        for (size_t x = 0; x < field.sizeX; ++x) {
+            for (size_t y = 0; y < field.sizeY; ++y) {
+                const uint8_t* row = field.alive.data() + field.index(x, y, 0);
+                for (size_t z0 = 0; z0 < field.sizeZ; z0 += chunk_size) {
+                    const size_t z1 = std::min(field.sizeZ, z0 + chunk_size);
+                    // Sparse fields are mostly dead parts of rows
+                    if (std::memcmp(row + z0, dead, z1 - z0) == 0)
+                        continue;
+
+                    ChunkEntry& entry = index[(x / chunk_size * chunksY
+                                               + y / chunk_size) * chunksZ
+                                              + z0 / chunk_size];
+                    for (size_t z = z0; z < z1; ++z) {
+                        if (!row[z])
+                            continue;
+
+                        const uint8_t local[3] = {
+                                static_cast<uint8_t>(x % chunk_size),
+                                static_cast<uint8_t>(y % chunk_size),
+                                static_cast<uint8_t>(z % chunk_size)};
+                        for (size_t i = 0; i < 3; ++i) {
+                            entry.min[i] = entry.population
+                                           ? std::min(entry.min[i], local[i])
+                                           : local[i];
+                            entry.max[i] = entry.population
+                                           ? std::max(entry.max[i], local[i])
+                                           : local[i];
+                        }
+                        ++entry.population;
+                    }
+                }
+            }
+        }
+
+        // Index and checksums go after colors, checksums of entries
+        // are known only when colors are written
+        uint64_t offset = align_up(header.aliveOffset + header.aliveSize);
+        if (info.hasColors) {
+            header.colorsOffset = offset;
+            for (ChunkEntry& entry: index) {
+                if (entry.population == 0)
+                    continue;
+                entry.colorsOffset = offset;
+                offset += entry.population * sizeof(uint16_t);
+            }
+            header.colorsSize = offset - header.colorsOffset;
+        }
+        header.chunkSize = chunk_size;
+        header.indexOffset = align_up(offset);
+        header.indexSize = index.size() * sizeof(ChunkEntry);
+        header.checksumBlock = checksum_block;
+        header.checksumsOffset = align_up(header.indexOffset
+                                          + header.indexSize);
+        header.checksumsSize = blocks_of(header.aliveSize) * sizeof(uint32_t);
+        header.headerChecksum = header_checksum(header);
+
+        // Written to temporary file and renamed, so broken save
+        // never replaces previous snapshot
+        const std::string tmpFile = file + ".tmp";
+        std::error_code ec;
+        try {
+            // Cells are packed right to buffers of writer while
+            // previous buffers are written
+            utils::AsyncFileWriter out(tmpFile, directIo);
+            out.write(&header, sizeof(header));
+            out.pad(plane_alignment);
+            std::vector<uint32_t> checksums(blocks_of(header.aliveSize));
+            uint64_t packed = 0;
+            for (size_t start = 0; start < cells;) {
+                auto [bits, space] = out.acquire();
+                const size_t count = std::min(cells - start, space * 8);
+                pack_alive(field.alive.data() + start, count, bits);
+                const size_t size = (count + 7) / 8;
+
+                // Blocks are checked while packed bytes are in cache
+                for (size_t done = 0; done < size;) {
+                    const uint64_t block = packed / checksum_block;
+                    const size_t part = std::min<uint64_t>(
+                            size - done, (block + 1) * checksum_block - packed);
+                    checksums[block] = utils::checksum::crc32c(
+                            bits + done, part, checksums[block]);
+                    done += part;
+                    packed += part;
+                }
+
+                out.commit(size);
+                start += count;
+            }
+            out.pad(plane_alignment);
+
+            // Colors of chunk go in order of live cells of its bounding box
+            if (info.hasColors) {
+                std::vector<uint16_t> colors;
+                colors.reserve(chunk_size * chunk_size * chunk_size);
+                for (size_t idx = 0; idx < index.size(); ++idx) {
+                    const ChunkEntry& entry = index[idx];
+                    if (entry.population == 0)
+                        continue;
+
+                    const size_t x0 = idx / chunksZ / chunksY * chunk_size;
+                    const size_t y0 = idx / chunksZ % chunksY * chunk_size;
+                    const size_t z0 = idx % chunksZ * chunk_size;
+                    colors.clear();
+                    for (size_t x = x0 + entry.min[0]; x <= x0 + entry.max[0];
+                         ++x)
+                        for (size_t y = y0 + entry.min[1];
+                             y <= y0 + entry.max[1]; ++y)
+                            for (size_t z = z0 + entry.min[2];
+                                 z <= z0 + entry.max[2]; ++z) {
+                                const size_t cell = field.index(x, y, z);
+                                if (field.alive[cell])
+                                    colors.push_back(
+                                            to_rgb565(field.colors[cell]));
+                            }
+                    const size_t size = colors.size() * sizeof(uint16_t);
+                    out.write(colors.data(), size);
+                    index[idx].checksum = utils::checksum::crc32c(
+                            colors.data(), size);
+                }
+            }
+
+            for (ChunkEntry& entry: index)
+                entry.checksum = entry_checksum(entry, entry.checksum);
+            out.pad(plane_alignment);
+            out.write(index.data(), header.indexSize);
+            out.pad(plane_alignment);
+            out.write(checksums.data(), header.checksumsSize);
+
+            out.finish();
+            std::filesystem::rename(tmpFile, file, ec);
+            if (!ec)
+                utils::sync_directory(file);
+        } catch (const FSException&) {
+            std::filesystem::remove(tmpFile, ec);
+            throw;
+        }
+
+        if (ec) {
+            std::filesystem::remove(tmpFile, ec);
+            throw FSException((format("Unable to write snapshot %s\n")
+                               % file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+        }
+    }
+
+    SnapshotInfo load(const std::string& file, FieldComponent& field,
+                      ThreadPool* pool)
+    {
+        utils::FileMapping mapping(file);
+        const SnapshotHeader header = read_header(file, mapping);
+        if (header.indexSize == 0) {
+            decode_plane(file, header, mapping, field, pool);
+            return info_of(header);
+        }
+
+        const Box box{{0, 0, 0}, {header.sizeX, header.sizeY, header.sizeZ}};
+        check_index(file, header, mapping, box, pool);
+        check_alive(file, header, mapping, box, pool);
+        field.resize(header.sizeX, header.sizeY, header.sizeZ);
+        field.generation = header.generation;
+        try {
+            decode_chunks(file, header, mapping, box, field);
+        } catch (const FSException&) {
+            field.resize(header.sizeX, header.sizeY, header.sizeZ);
+            throw;
+        }
+
+        return info_of(header);
+    }
+
+    SnapshotInfo loadRegion(const std::string& file, FieldComponent& field,
+                            const Region& region, ThreadPool* pool)
+    {
+        utils::FileMapping mapping(file);
+        const SnapshotHeader header = read_header(file, mapping);
+
+        const uint64_t sizes[3] = {header.sizeX, header.sizeY, header.sizeZ};
+        const uint64_t begin[3] = {region.x, region.y, region.z};
+        const uint64_t regionSizes[3] = {region.sizeX, region.sizeY,
+                                         region.sizeZ};
+        Box box{};
+        for (size_t i = 0; i < 3; ++i) {
+            box.begin[i] = std::min(begin[i], sizes[i]);
+            box.end[i] = box.begin[i]
+                         + std::min(regionSizes[i], sizes[i] - box.begin[i]);
+            if (box.begin[i] == box.end[i])
+                throw FSException((format("Region is out of field %s\n")
+                                   % file).str(),
+                                  program_log_file_name(),
+                                  Category::FILE_ERROR);
+        }
+
+        const uint64_t boxX = box.end[0] - box.begin[0];
+        const uint64_t boxY = box.end[1] - box.begin[1];
+        const uint64_t boxZ = box.end[2] - box.begin[2];
+        if (header.indexSize == 0) {
+            // Without index the whole field is decoded and cut
+            FieldComponent whole;
+            decode_plane(file, header, mapping, whole, pool);
+            field.resize(boxX, boxY, boxZ);
+            field.generation = header.generation;
+            for (uint64_t x = 0; x < boxX; ++x) {
+                for (uint64_t y = 0; y < boxY; ++y) {
+                    const size_t from = whole.index(box.begin[0] + x,
+                                                    box.begin[1] + y,
+                                                    box.begin[2]);
+                    const size_t to = field.index(x, y, 0);
+                    std::copy_n(whole.alive.begin() + from, boxZ,
+                                field.alive.begin() + to);
+                    std::copy_n(whole.colors.begin() + from, boxZ,
+                                field.colors.begin() + to);
+                }
+            }
+
+            return info_of(header);
+        }
+
+        check_index(file, header, mapping, box, pool);
+        check_alive(file, header, mapping, box, pool);
+        field.resize(boxX, boxY, boxZ);
+        field.generation = header.generation;
+        try {
+            decode_chunks(file, header, mapping, box, field);
+        } catch (const FSException&) {
+            field.resize(boxX, boxY, boxZ);
+            throw;
+        }
+
+        return info_of(header);
+    }
+
+    std::vector<ChunkSummary> readIndex(const std::string& file)
+    {
+        utils::FileMapping mapping(file);
+        const SnapshotHeader header = read_header(file, mapping);
+        if (header.indexSize == 0)
+            throw FSException((format("Snapshot %s has no chunk index\n")
+                               % file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+        check_index(file, header, mapping,
+                    {{0, 0, 0}, {header.sizeX, header.sizeY, header.sizeZ}},
+                    nullptr);
+
+        const uint64_t chunksY = chunks_of(header.sizeY);
+        const uint64_t chunksZ = chunks_of(header.sizeZ);
+        const uint8_t* index = mapping.data() + header.indexOffset;
+        std::vector<ChunkSummary> chunks;
+        for (uint64_t idx = 0; idx < header.indexSize / sizeof(ChunkEntry);
+             ++idx) {
+            ChunkEntry entry{};
+            std::memcpy(&entry, index + idx * sizeof(entry), sizeof(entry));
+            if (entry.population == 0)
+                continue;
+
+            const uint64_t x = idx / chunksZ / chunksY * chunk_size;
+            const uint64_t y = idx / chunksZ % chunksY * chunk_size;
+            const uint64_t z = idx % chunksZ * chunk_size;
+            chunks.push_back({x, y, z, entry.population,
+                              x + entry.min[0], y + entry.min[1],
+                              z + entry.min[2], x + entry.max[0],
+                              y + entry.max[1], z + entry.max[2]});
+        }
+
+        return chunks;
+    }
+
+    SnapshotLayout readLayout(const std::string& file)
+    {
+        utils::FileMapping mapping(file);
+        return layout_of(read_header(file, mapping));
+    }
+
+    SnapshotLayout create(const std::string& file, uint64_t sizeX,
+                          uint64_t sizeY, uint64_t sizeZ, uint64_t generation,
+                          const SnapshotInfo& info)
+    {
+        if (sizeX > max_side || sizeY > max_side || sizeZ > max_side
+            || sizeX * sizeY * sizeZ > max_cells)
+            throw FSException((format("Field %dx%dx%d is too large\n")
+                               % sizeX % sizeY % sizeZ).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+        header.version = snapshot_version;
+        header.headerSize = sizeof(header);
+        header.sizeX = sizeX;
+        header.sizeY = sizeY;
+        header.sizeZ = sizeZ;
+        header.generation = generation;
+        header.neirCount = info.neirCount;
+        header.neirCountDie = info.neirCountDie;
+        header.neighbours = neighbours_count;
+        header.boundary = static_cast<uint32_t>(info.boundary);
+        header.aliveOffset = align_up(sizeof(header));
+        header.aliveSize = (sizeX * sizeY * sizeZ + 7) / 8;
+        // Out of core field has no chunk index, it is read by planes.
+        // Checksums are written by the one who fills alive plane
+        header.checksumBlock = checksum_block;
+        header.checksumsOffset = align_up(header.aliveOffset
+                                          + header.aliveSize);
+        header.checksumsSize = blocks_of(header.aliveSize) * sizeof(uint32_t);
+        header.headerChecksum = header_checksum(header);
+
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+
+        std::error_code ec;
+        if (out)
+            std::filesystem::resize_file(file, header.checksumsOffset
+                                               + header.checksumsSize, ec);
+        if (!out || ec)
+            throw FSException((format("Unable to create snapshot %s\n")
+                               % file).str(),
+                              program_log_file_name(), Category::FILE_ERROR);
+
+        return layout_of(header);
+    }
+
+    void checkBlocks(const std::string& file, const uint8_t* data,
+                     const SnapshotLayout& layout, uint64_t first,
+                     uint64_t last, ThreadPool* pool)
+    {
+        if (layout.checksumBlock == 0)
+            return;
+
+        std::vector<uint64_t> blocks;
+        for (uint64_t b = first; b < std::min(last, blocksCount(layout)); ++b)
+            blocks.push_back(b);
+        check_blocks(file, data, layout, blocks, pool);
+    }
+
+    void writeChecksums(uint8_t* data, const SnapshotLayout& layout,
+                        uint64_t first, uint64_t last)
+    {
+        const uint8_t* bits = data + layout.aliveOffset;
+        uint8_t* checksums = data + layout.checksumsOffset;
+        for (uint64_t b = first; b < std::min(last, blocksCount(layout)); ++b) {
+            const uint64_t begin = b * layout.checksumBlock;
+            const uint32_t checksum = utils::checksum::crc32c(
+                    bits + begin, std::min<uint64_t>(layout.checksumBlock,
+                                                     layout.aliveSize - begin));
+            std::memcpy(checksums + b * sizeof(checksum), &checksum,
+                        sizeof(checksum));
+        }
+    }
+
+    uint64_t blocksCount(const SnapshotLayout& layout)
+    {
+        return layout.checksumBlock == 0 ? 0 : blocks_of(layout.aliveSize);
+    }
+}
@@ -9,104 +9,378 @@
 #include <boost/algorithm/string/trim.hpp>
 #include <SDL_image.h>
 #include <fstream>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "utils/texture.hpp"
 #include "utils/logger.hpp"
-#include "utils/string.hpp"
 #include "constants.hpp"
 #include "exceptions/fsexception.hpp"
 #include "exceptions/sdlexception.hpp"
 #include "exceptions/glexception.hpp"
 
 using boost::format;
-using utils::string::split;
 
-std::vector<GLfloat>
-utils::texture::loadObj(const std::string& file, std::string& textureFile)
+namespace
 {
-    // TODO: write more general cache
-    static std::vector<GLfloat> last_result = {};
-    static std::string last_file = "";
-    static std::string last_tex_file = "";
+    const char mesh_cache_magic[4] = {'L', 'M', 'S', 'H'};
+    const uint32_t mesh_cache_version = 1;
+    const char* mesh_cache_ext = ".meshcache";
 
-    if (!last_result.empty() && last_file == file) {
-        textureFile = last_tex_file;
-        return last_result;
+    /**
+     * Mesh cache file starts with this header, then go
+     * vertices, indices and texture file name
+     */
+    struct MeshCacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        // Size and modification time of obj file cache is built from
+        uint64_t objSize;
+        int64_t objTime;
+        uint32_t verticesCount;
+        uint32_t indicesCount;
+        uint32_t textureFileSize;
+        uint32_t reserved;
+    };
+
+    std::string read_file(const std::string& file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            throw FSException((format("Can't open file %s") % file).str(),
+                              program_log_file_name(),
+                              utils::log::Category::FILE_ERROR);
+
+        std::string data;
+        in.seekg(0, std::ios::end);
+        data.resize(in.tellg());
+        in.seekg(0, std::ios::beg);
+        in.read(data.data(), data.size());
+
+        return data;
+    }
+
+    /**
+     * Cut next line from text without line ending
+     * @param text
+     * @return
+     */
+    std::string_view next_line(std::string_view& text)
+    {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        return line;
+    }
+
+    /**
+     * Cut next space separated token from line
+     * @param line
+     * @return
+     */
+    std::string_view next_token(std::string_view& line)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            line = {};
+            return {};
+        }
+
+        line.remove_prefix(start);
+        size_t end = line.find_first_of(" \t");
+        std::string_view token = line.substr(0, end);
+        line.remove_prefix(token.size());
+
+        return token;
+    }
+
+    template<class T>
+    T parse_number(std::string_view token, const std::string& file)
+    {
+        T value{};
+        auto [ptr, ec] = std::from_chars(token.data(),
+                                         token.data() + token.size(), value);
+        if (ec != std::errc())
+            throw FSException((format("Bad number \"%s\" in %s")
+                               % token % file).str(),
+                              program_log_file_name(),
+                              utils::log::Category::FILE_ERROR);
+
+        return value;
+    }
+
+    /**
+     * Convert obj index which is 1-based or negative (relative to end)
+     * @param token
+     * @param count
+     * @param file
+     * @return
+     */
+    uint32_t parse_index(std::string_view token, size_t count,
+                         const std::string& file)
+    {
+        auto idx = parse_number<int64_t>(token, file);
+        int64_t res = idx < 0 ? static_cast<int64_t>(count) + idx : idx - 1;
+        if (idx == 0 || res < 0 || res >= static_cast<int64_t>(count))
+            throw FSException((format("Index %d is out of range in %s")
+                               % idx % file).str(),
+                              program_log_file_name(),
+                              utils::log::Category::FILE_ERROR);
+
+        return res;
+    }
+
+    std::string read_texture_file(const std::string& mtlFile)
+    {
+        const std::string mtlPath = getResourcePath(mtlFile);
+        if (!std::filesystem::exists(mtlPath))
+            throw FSException((format("File: %s doesn't exists") % mtlPath).str(),
+                              program_log_file_name(),
+                              utils::log::Category::FILE_ERROR);
+
+        std::string data = read_file(mtlPath);
+        std::string_view text = data;
+        while (!text.empty()) {
+            std::string_view line = next_line(text);
+            if (next_token(line) == "map_Kd") {
+                std::string textureFile(line);
+                boost::trim(textureFile);
+                return textureFile;
+            }
+        }
+
+        return {};
+    }
+
+    int64_t file_time(const std::string& file)
+    {
+        return std::filesystem::last_write_time(file).time_since_epoch().count();
+    }
+
+    /**
+     * Map cache file and copy mesh from it
+     * @param cacheFile
+     * @param objSize
+     * @param objTime
+     * @param mesh
+     * @return false if cache is missing, broken or stale
+     */
+    bool load_mesh_cache(const std::string& cacheFile, uint64_t objSize,
+                         int64_t objTime, utils::texture::Mesh& mesh)
+    {
+        int fd = open(cacheFile.c_str(), O_RDONLY);
+        if (fd == -1)
+            return false;
+
+        struct stat st{};
+        if (fstat(fd, &st) == -1
+            || static_cast<size_t>(st.st_size) < sizeof(MeshCacheHeader)) {
+            close(fd);
+            return false;
+        }
+
+        size_t size = st.st_size;
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            return false;
+
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        MeshCacheHeader header{};
+        std::memcpy(&header, bytes, sizeof(header));
+
+        size_t verticesSize = header.verticesCount * sizeof(GLfloat);
+        size_t indicesSize = header.indicesCount * sizeof(GLuint);
+        bool valid = std::memcmp(header.magic, mesh_cache_magic,
+                                 sizeof(mesh_cache_magic)) == 0
+                     && header.version == mesh_cache_version
+                     && header.objSize == objSize
+                     && header.objTime == objTime
+                     && size == sizeof(header) + verticesSize + indicesSize
+                                + header.textureFileSize;
+
+        if (valid) {
+            bytes += sizeof(header);
+            mesh.vertices.resize(header.verticesCount);
+            std::memcpy(mesh.vertices.data(), bytes, verticesSize);
+            bytes += verticesSize;
+            mesh.indices.resize(header.indicesCount);
+            std::memcpy(mesh.indices.data(), bytes, indicesSize);
+            bytes += indicesSize;
+            mesh.textureFile.assign(reinterpret_cast<const char*>(bytes),
+                                    header.textureFileSize);
+        }
+
+        munmap(data, size);
+        return valid;
     }
 
+    /**
+     * Write cache to temporary file and rename it, so readers
+     * never see partially written cache
+     * @param cacheFile
+     * @param objSize
+     * @param objTime
+     * @param mesh
+     */
+    void save_mesh_cache(const std::string& cacheFile, uint64_t objSize,
+                         int64_t objTime, const utils::texture::Mesh& mesh)
+    {
+        MeshCacheHeader header{};
+        std::memcpy(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic));
+        header.version = mesh_cache_version;
+        header.objSize = objSize;
+        header.objTime = objTime;
+        header.verticesCount = mesh.vertices.size();
+        header.indicesCount = mesh.indices.size();
+        header.textureFileSize = mesh.textureFile.size();
+
+        const std::string tmpFile = cacheFile + ".tmp";
+        std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(mesh.vertices.data()),
+                  mesh.vertices.size() * sizeof(GLfloat));
+        out.write(reinterpret_cast<const char*>(mesh.indices.data()),
+                  mesh.indices.size() * sizeof(GLuint));
+        out.write(mesh.textureFile.data(), mesh.textureFile.size());
+        out.close();
+
+        std::error_code ec;
+        if (out)
+            std::filesystem::rename(tmpFile, cacheFile, ec);
+
+        // Resources may be read only, obj is parsed on every start then
+        if (!out || ec) {
+            std::filesystem::remove(tmpFile, ec);
+            utils::log::Logger::write(program_log_file_name(),
+                                      utils::log::Category::INFO,
+                                      (format("Can't write mesh cache %s\n")
+                                       % cacheFile).str());
+        }
+    }
+}
+
+utils::texture::Mesh utils::texture::loadObj(const std::string& file)
+{
     if (!std::filesystem::exists(file))
         throw FSException((format("File %s doesn't exists") % file).str(),
                           program_log_file_name(),
                           utils::log::Category::FILE_ERROR);
 
-    std::ifstream obj(file);
-    std::string line;
-    std::string mtlFile;
+    const std::string data = read_file(file);
+    std::string_view text = data;
+
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec2> uv;
-    std::vector<glm::vec3> indices;
-    while (std::getline(obj, line)) {
-        if (line.starts_with("vt")) {
-            GLfloat x, y;
-            std::string data = line.substr(line.find(' ')); // Skip "vt"
-            std::istringstream s(data);
-            s >> x >> y;
-            uv.emplace_back(x, y);
-        } else if (line.starts_with("v") && !line.starts_with("vn")) {
-            GLfloat x, y, z;
-            std::string data = line.substr(line.find(' ')); // Skip "v"
-            std::istringstream s(data);
-            s >> x >> y >> z;
-            vertices.emplace_back(x, y, z);
-        } else if (line.starts_with("f")) {
-            std::string data = line.substr(line.find(' ')); // Skip "f"
-
-            std::vector<std::string> parts = split(data, " ");
-            for (auto& str: parts) {
-                std::vector<std::string> idx = split(str, "/");
-                size_t vertexIdx = std::stol(idx[0]);
-//                size_t normalIdx = std::stol(idx[1]);
-                size_t textureIdx = std::stol(idx[1]);
-                indices.emplace_back(vertexIdx - 1, 0, textureIdx - 1);
+    std::string mtlFile;
+
+    Mesh mesh;
+    // Position and uv indices packed to key of mesh vertex
+    std::unordered_map<uint64_t, GLuint> meshVertices;
+    std::vector<GLuint> polygon;
+
+    auto add_vertex = [&](std::string_view token) {
+        size_t slash = token.find('/');
+        uint32_t vertexIdx = parse_index(token.substr(0, slash),
+                                         vertices.size(), file);
+        uint32_t uvIdx = 0;
+        bool hasUV = false;
+        if (slash != std::string_view::npos) {
+            std::string_view rest = token.substr(slash + 1);
+            rest = rest.substr(0, rest.find('/'));
+            if (!rest.empty()) {
+                uvIdx = parse_index(rest, uv.size(), file);
+                hasUV = true;
             }
-        } else if (line.starts_with("mtllib")) {
-            mtlFile = line.substr(line.find(' '));
+        }
+
+        uint64_t key = (static_cast<uint64_t>(vertexIdx) << 32)
+                       | (hasUV ? uvIdx + 1 : 0);
+        auto [it, inserted] = meshVertices.try_emplace(
+                key, mesh.vertices.size() / 5);
+        if (inserted) {
+            const glm::vec3& pos = vertices[vertexIdx];
+            const glm::vec2 coords = hasUV ? uv[uvIdx] : glm::vec2(0.f);
+            mesh.vertices.insert(mesh.vertices.end(),
+                                 {pos.x, pos.y, pos.z, coords.x, coords.y});
+        }
+
+        return it->second;
+    };
+
+    while (!text.empty()) {
+        std::string_view line = next_line(text);
+        std::string_view type = next_token(line);
+
+        if (type == "v") {
+            GLfloat x = parse_number<GLfloat>(next_token(line), file);
+            GLfloat y = parse_number<GLfloat>(next_token(line), file);
+            GLfloat z = parse_number<GLfloat>(next_token(line), file);
+            vertices.emplace_back(x, y, z);
+        } else if (type == "vt") {
+            GLfloat x = parse_number<GLfloat>(next_token(line), file);
+            GLfloat y = parse_number<GLfloat>(next_token(line), file);
+            uv.emplace_back(x, y);
+        } else if (type == "f") {
+            polygon.clear();
+            for (auto token = next_token(line); !token.empty();
+                 token = next_token(line))
+                polygon.push_back(add_vertex(token));
+
+            // Triangle fan
+            for (size_t i = 2; i < polygon.size(); ++i)
+                mesh.indices.insert(mesh.indices.end(),
+                                    {polygon[0], polygon[i - 1], polygon[i]});
+        } else if (type == "mtllib") {
+            mtlFile = line;
             boost::trim(mtlFile);
         }
     }
-    obj.close();
-
-    std::vector<GLfloat> res;
-    for (const glm::vec3& data: indices) {
-        res.emplace_back(vertices[data[0]].x); // Vertex coords
-        res.emplace_back(vertices[data[0]].y);
-        res.emplace_back(vertices[data[0]].z);
-        res.emplace_back(uv[data[1]].x); // UV coords
-        res.emplace_back(uv[data[1]].y);
-    }
 
     // Extract texture file name from mtl file
-    const std::string mtlPath = getResourcePath(mtlFile);
-    if (!std::filesystem::exists(getResourcePath(mtlPath)))
-        throw FSException((format("File: %s doesn't exists") % mtlPath).str(),
+    mesh.textureFile = read_texture_file(mtlFile);
+
+    return mesh;
+}
+
+utils::texture::Mesh utils::texture::loadMesh(const std::string& file)
+{
+    // TODO: write more general cache
+    static Mesh last_result;
+    static std::string last_file;
+
+    if (!last_result.indices.empty() && last_file == file)
+        return last_result;
+
+    if (!std::filesystem::exists(file))
+        throw FSException((format("File %s doesn't exists") % file).str(),
                           program_log_file_name(),
                           utils::log::Category::FILE_ERROR);
 
-    std::ifstream mtl(getResourcePath(mtlPath));
-    while (std::getline(mtl, line)) {
-        if (line.starts_with("map_Kd")) {
-            textureFile = line.substr(line.find("map_Kd") + 6);
-            boost::trim(textureFile);
-            break;
-        }
+    const std::string cacheFile = file + mesh_cache_ext;
+    const uint64_t objSize = std::filesystem::file_size(file);
+    const int64_t objTime = file_time(file);
+
+    Mesh mesh;
+    if (!load_mesh_cache(cacheFile, objSize, objTime, mesh)) {
+        mesh = loadObj(file);
+        save_mesh_cache(cacheFile, objSize, objTime, mesh);
     }
-    mtl.close();
 
-    last_result = res;
+    last_result = mesh;
     last_file = file;
-    last_tex_file = textureFile;
 
-    return res;
+    return mesh;
 }
 
 GLuint utils::texture::loadTexture(const std::string &file,
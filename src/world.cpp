@@ -5,6 +5,8 @@
 #include <imgui_impl_opengl3.h>
 #include <iostream>
 #include <thread>
+#include <algorithm>
+#include <utility>
 
 #include "base.hpp"
 #include "world.hpp"
@@ -12,7 +14,7 @@
 #include "game.hpp"
 #include "utils/math.hpp"
 #include "components/positioncomponent.hpp"
-#include "components/cellcomponent.hpp"
+#include "components/fieldcomponent.hpp"
 #include "components/spritecomponent.hpp"
 #include "systems/renderersystem.hpp"
 #include "components/textcomponent.hpp"
@@ -24,6 +26,11 @@
 #include "exceptions/sdlexception.hpp"
 #include "exceptions/glexception.hpp"
 #include "lifeprogram.hpp"
+#include "utils/snapshot.hpp"
+#include "utils/checkpointer.hpp"
+#include "utils/journal.hpp"
+#include "utils/pattern.hpp"
+#include "utils/sharedfieldwriter.hpp"
 
 using utils::log::Logger;
 using utils::log::program_log_file_name;
@@ -37,10 +44,12 @@ using std::find_if;
 using utils::fix_coords;
 
 const GLfloat cubeSize = 20.f;
+// Name of entity which holds field
+const size_t field_entity = 0;
 
-World::World() : m_wasInit(false),
-                 m_cells(boost::extents[6][6][6]),
-                 m_pool(get_thread_count())
+World::World() : ecs::EcsManager(get_thread_count()),
+                 m_fieldSize(0), m_history(0), m_wasInit(false),
+                 m_recordPending(false)
 {
     if (!Config::hasKey("FieldSize"))
         Config::addVal("FieldSize", 6, "int");
@@ -66,10 +75,63 @@ World::World() : m_wasInit(false),
         Config::addVal("CellBorderColor", glm::vec4(1.f, 1.f, 1.f, 1.f), "vec4");
     if (!Config::hasKey("ColoredLife"))
         Config::addVal("ColoredLife", false, "bool");
+    if (!Config::hasKey("SurfaceMesh"))
+        Config::addVal("SurfaceMesh", true, "bool");
+    if (!Config::hasKey("LodDistance"))
+        Config::addVal("LodDistance", 4000.f, "float");
+    if (!Config::hasKey("SnapshotFile"))
+        Config::addVal("SnapshotFile", std::string("simulation.lifesnap"),
+                       "string");
+    // Part of snapshot shown on load, zero size loads the whole field
+    if (!Config::hasKey("SnapshotRegionX"))
+        Config::addVal("SnapshotRegionX", 0, "int");
+    if (!Config::hasKey("SnapshotRegionY"))
+        Config::addVal("SnapshotRegionY", 0, "int");
+    if (!Config::hasKey("SnapshotRegionZ"))
+        Config::addVal("SnapshotRegionZ", 0, "int");
+    if (!Config::hasKey("SnapshotRegionSize"))
+        Config::addVal("SnapshotRegionSize", 0, "int");
+    // Generations between checkpoints, 0 disables checkpoints
+    if (!Config::hasKey("CheckpointInterval"))
+        Config::addVal("CheckpointInterval", 0, "int");
+    if (!Config::hasKey("CheckpointCount"))
+        Config::addVal("CheckpointCount", 3, "int");
+    if (!Config::hasKey("CheckpointDir"))
+        Config::addVal("CheckpointDir", std::string("checkpoints"), "string");
+    // Snapshots and checkpoints bypass page cache
+    if (!Config::hasKey("DirectIO"))
+        Config::addVal("DirectIO", false, "bool");
+    if (!Config::hasKey("RecordJournal"))
+        Config::addVal("RecordJournal", false, "bool");
+    if (!Config::hasKey("JournalFile"))
+        Config::addVal("JournalFile", std::string("simulation.lifejournal"),
+                       "string");
+    if (!Config::hasKey("JournalKeyframeInterval"))
+        Config::addVal("JournalKeyframeInterval", 100, "int");
+    // Initial pattern (.rle, .vox or x y z lines), empty for built-in one
+    if (!Config::hasKey("PatternFile"))
+        Config::addVal("PatternFile", std::string(""), "string");
+    if (!Config::hasKey("PatternOffsetX"))
+        Config::addVal("PatternOffsetX", 0, "int");
+    if (!Config::hasKey("PatternOffsetY"))
+        Config::addVal("PatternOffsetY", 0, "int");
+    if (!Config::hasKey("PatternOffsetZ"))
+        Config::addVal("PatternOffsetZ", 0, "int");
+    // Megabytes of generations history, 0 disables history
+    if (!Config::hasKey("HistoryMemory"))
+        Config::addVal("HistoryMemory", 256, "int");
+    // Shared memory name for external tools, e.g. /lifegame_field,
+    // empty disables publishing
+    if (!Config::hasKey("SharedFieldName"))
+        Config::addVal("SharedFieldName", std::string(""), "string");
 }
 
 World::~World()
 {
+    // Gui isn't created without window
+    if (isHeadless())
+        return;
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -77,6 +139,8 @@ World::~World()
 
 void World::update(size_t delta)
 {
+    nextFrame();
+
     if constexpr (debug)
         m_fps.update();
 
@@ -109,191 +173,400 @@ void World::update(size_t delta)
         std::cout << "Timer started" << std::endl;
     }
 
+    switch (takeSimulationRequest()) {
+        case SimulationRequest::SAVE:
+            save_simulation();
+            break;
+        case SimulationRequest::LOAD:
+            load_simulation();
+            break;
+        case SimulationRequest::REPLAY:
+            start_replay();
+            break;
+        case SimulationRequest::NONE:
+            break;
+    }
+
+    if (auto generation = takeHistorySeek())
+        seek_history(*generation);
+
     if (getGameState() == GameStates::PLAY) {
+        // Headless run records each generation as frame
         GLfloat stepTime = Config::getVal<GLfloat>("StepTime");
-        if (m_timer.getTicks() / 1000.f > stepTime) {
+        if (isHeadless() || m_timer.getTicks() / 1000.f > stepTime) {
             m_timer.stop();
             m_timer.start();
-            update_field();
-            std::cout << "Field updated" << std::endl;
+            if (m_journalReader) {
+                replay_field();
+            } else {
+                if (std::exchange(m_recordPending, false))
+                    start_recording();
+                update_field();
+                std::cout << "Field updated" << std::endl;
+            }
         }
     }
 
+    publish_field();
+
 //    filter_entities();
-    for (auto &system: m_systems)
-        system.second->update(delta);
+    updateSystems(delta);
 }
 
 void World::init()
 {
-    m_systems.clear();
-    createSystem<KeyboardSystem>();
+    clearSystems();
+    if (!isHeadless())
+        createSystem<KeyboardSystem>();
     createSystem<RendererSystem>();
     createSystem<AnimationSystem>();
     createSystem<PhysicsSystem>();
     createSystem<ParticleRenderSystem>();
 
+    // New simulation is never replay and starts new journal
+    m_journalReader.reset();
+    m_journalWriter.reset();
+    m_history.clear();
     m_fieldSize = Config::getVal<int>("FieldSize");
     init_field();
 
+    // Run with checkpoints continues from the last one after restart
+    if (!m_wasInit && Config::getVal<int>("CheckpointInterval") > 0)
+        resume_checkpoint();
+    m_recordPending = true;
+    publish_history();
+
     m_wasInit = true;
 }
 
 void World::update_field()
 {
-    FieldState new_state(boost::extents[m_fieldSize][m_fieldSize][m_fieldSize]);
+    using utils::math::operator/;
+
+    FieldComponent& field = *m_field;
+    m_nextAlive.resize(field.size());
+    m_nextColors.resize(field.size());
+    ++field.version;
+
+    // 6 faces and 8 corners
+    static constexpr int neighbours[14][3] = {
+            {0, 1, 0}, {0, -1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 0, 1}, {0, 0, -1},
+            {-1, 1, -1}, {1, 1, -1}, {1, 1, 1}, {-1, 1, 1},
+            {-1, -1, -1}, {1, -1, -1}, {1, -1, 1}, {-1, -1, 1}
+    };
 
     size_t neirCountToDie = Config::getVal<int>("NeirCountDie");
     size_t neirCountToLife = Config::getVal<int>("NeirCount");
-    auto func = [this, &new_state, neirCountToDie, neirCountToLife](int start, int end){
-        using namespace utils::math;
-
-        for (CellIndex i = start; i < end; ++i) {
-            for (CellIndex j = start; j < end; ++j) {
-                for (CellIndex k = start; k < end; ++k) {
-                    const auto& cell = m_cells[i][j][k];
+    // Each job owns whole chunks along x, so chunk versions
+    // are never written from two threads
+    auto func = [this, &field, neirCountToDie, neirCountToLife](size_t start,
+                                                               size_t end) {
+        const auto sizeX = static_cast<long>(field.sizeX);
+        const auto sizeY = static_cast<long>(field.sizeY);
+        const auto sizeZ = static_cast<long>(field.sizeZ);
+        for (long i = start; i < static_cast<long>(end); ++i) {
+            for (long j = 0; j < sizeY; ++j) {
+                for (long k = 0; k < sizeZ; ++k) {
                     size_t neirCount = 0;
                     glm::vec4 color = {0, 0, 0, 0};
-                    bool hasUp =
-                            (j != end - 1) ?
-                            m_cells[i][j + 1][k]->alive : false;
-                    if (hasUp) {
-                        ++neirCount;
-                        color += m_cells[i][j + 1][k]->color;
-                    }
-
-                    bool hasDown =
-                            (j != 0) ?
-                            m_cells[i][j - 1][k]->alive : false;
-                    if (hasDown) {
-                        ++neirCount;
-                        color += m_cells[i][j - 1][k]->color;
-                    }
-                    bool hasLeft =
-                            (i != 0) ?
-                            m_cells[i - 1][j][k]->alive : false;
-                    if (hasLeft) {
-                        color += m_cells[i - 1][j][k]->color;
-                        ++neirCount;
-                    }
-                    bool hasRight =
-                            (i != end - 1) ?
-                            m_cells[i + 1][j][k]->alive : false;
-                    if (hasRight) {
-                        color += m_cells[i + 1][j][k]->color;
-                        ++neirCount;
-                    }
-                    bool hasForward =
-                            (k != end - 1) ?
-                            m_cells[i][j][k + 1]->alive : false;
-                    if (hasForward) {
-                        color += m_cells[i][j][k + 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasBack =
-                            (k != 0) ?
-                            m_cells[i][j][k - 1]->alive : false;
-                    if (hasBack) {
-                        color += m_cells[i][j][k - 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasUpCor1 =
-                            (i != 0 && k != 0 && j != end - 1) ?
-                            m_cells[i - 1][j + 1][k - 1]->alive : false;
-                    if (hasUpCor1) {
-                        color += m_cells[i - 1][j + 1][k - 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasUpCor2 =
-                            (i != end - 1 && k != 0 && j != end - 1) ?
-                            m_cells[i + 1][j + 1][k - 1]->alive : false;
-                    if (hasUpCor2) {
-                        color += m_cells[i + 1][j + 1][k - 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasUpCor3 =
-                            (i != end - 1 && k != end - 1 && j != end - 1) ?
-                            m_cells[i + 1][j + 1][k + 1]->alive : false;
-                    if (hasUpCor3) {
-                        color += m_cells[i + 1][j + 1][k + 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasUpCor4 =
-                            (i != 0 && k != end - 1 && j != end - 1) ?
-                            m_cells[i - 1][j + 1][k + 1]->alive : false;
-                    if (hasUpCor4) {
-                        color += m_cells[i - 1][j + 1][k + 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasDownCor1 =
-                            (i != 0 && k != 0 && j != 0) ?
-                            m_cells[i - 1][j - 1][k - 1]->alive : false;
-                    if (hasDownCor1) {
-                        color += m_cells[i - 1][j - 1][k - 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasDownCor2 =
-                            (i != end - 1 && k != 0 && j != 0) ?
-                            m_cells[i + 1][j - 1][k - 1]->alive : false;
-                    if (hasDownCor2) {
-                        color += m_cells[i + 1][j - 1][k - 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasDownCor3 =
-                            (i != end - 1 && k != end - 1 && j != 0) ?
-                            m_cells[i + 1][j - 1][k + 1]->alive : false;
-                    if (hasDownCor3) {
-                        color += m_cells[i + 1][j - 1][k + 1]->color;
-                        ++neirCount;
-                    }
-                    bool hasDownCor4 =
-                            (i != 0 && k != end - 1 && j != 0) ?
-                            m_cells[i - 1][j - 1][k + 1]->alive : false;
-                    if (hasDownCor4) {
-                        color += m_cells[i - 1][j - 1][k + 1]->color;
-                        ++neirCount;
-                    }
-
-                    // Dead case
-                    if (!cell->alive) {
-                        if (neirCount >= neirCountToLife) {
-                            new_state[i][j][k].alive = true;
-                            new_state[i][j][k].color = color / neirCount;
+                    for (const auto& n: neighbours) {
+                        long x = i + n[0], y = j + n[1], z = k + n[2];
+                        if (x < 0 || y < 0 || z < 0
+                            || x >= sizeX || y >= sizeY || z >= sizeZ)
+                            continue;
+
+                        size_t idx = field.index(x, y, z);
+                        if (field.alive[idx]) {
+                            ++neirCount;
+                            color += unpack_color(field.colors[idx]);
                         }
+                    }
 
-                        continue;
+                    size_t idx = field.index(i, j, k);
+                    bool alive = field.alive[idx] != 0;
+                    uint32_t newColor = field.colors[idx];
+                    if (!alive && neirCount >= neirCountToLife) {
+                        // Dead case
+                        alive = true;
+                        newColor = pack_color(color / neirCount);
+                    } else if (alive && (neirCount < neirCountToLife
+                                         || neirCount >= neirCountToDie)) {
+                        // Life case
+                        alive = false;
                     }
 
-                    // Life case
-                    if (neirCount < neirCountToLife
-                        || neirCount >= neirCountToDie)
-                        new_state[i][j][k].alive = false;
+                    m_nextAlive[idx] = alive;
+                    m_nextColors[idx] = newColor;
+                    if (alive != (field.alive[idx] != 0)
+                        || newColor != field.colors[idx])
+                        field.markCellChanged(i, j, k);
                 }
             }
         }
     };
 
-    int threadCount = m_pool.getThreadsCount();
-    int partSize = threadCount / m_fieldSize;
-    int rem = threadCount % m_fieldSize;
-    size_t i;
-    for (i = 0; i < threadCount; ++i) {
-        if (i == threadCount - 1 && rem != 0)
-            m_pool.addJob(func, i * partSize, m_fieldSize);
-        else
-            m_pool.addJob(func, i * partSize, (i + 1) * partSize);
-    }
+    size_t threadCount = m_pool.getThreadsCount();
+    size_t chunksPerJob = (field.chunksX + threadCount - 1) / threadCount;
+    size_t slab = chunksPerJob * FieldComponent::chunk_size;
+    for (size_t start = 0; start < field.sizeX; start += slab)
+        m_pool.addJob(func, start, std::min(field.sizeX, start + slab));
 
     m_pool.waitForFinish();
 
-    for (i = 0; i < m_fieldSize; ++i) {
-        for (size_t j = 0; j < m_fieldSize; ++j) {
-            for (size_t k = 0; k < m_fieldSize; ++k) {
-                m_cells[i][j][k]->alive = new_state[i][j][k].alive;
-                m_cells[i][j][k]->color = new_state[i][j][k].color;
-            }
+    field.alive.swap(m_nextAlive);
+    field.colors.swap(m_nextColors);
+    ++field.generation;
+
+    markChanged<FieldComponent>(field_entity);
+
+    const int historyMemory = Config::getVal<int>("HistoryMemory");
+    if (historyMemory > 0) {
+        // Previous generation is in next planes after swap
+        m_history.setMemoryBudget(static_cast<size_t>(historyMemory) << 20);
+        m_history.push(field, m_nextAlive);
+    } else {
+        m_history.clear();
+    }
+    publish_history();
+
+    if (m_journalWriter) {
+        try {
+            m_journalWriter->append(field);
+        } catch (const BaseGameException& e) {
+            Logger::write(e.fileLog(), e.categoryError(), e.what());
+            m_journalWriter.reset();
+        }
+    }
+
+    const int interval = Config::getVal<int>("CheckpointInterval");
+    if (interval > 0 && field.generation % interval == 0)
+        checkpoint_field();
+}
+
+void World::save_simulation()
+{
+    // Nothing to save before first start
+    if (!m_field)
+        return;
+
+    const auto& file = Config::getVal<std::string>("SnapshotFile");
+    utils::snapshot::SnapshotInfo info{
+            static_cast<uint32_t>(Config::getVal<int>("NeirCount")),
+            static_cast<uint32_t>(Config::getVal<int>("NeirCountDie"))};
+    info.hasColors = Config::getVal<bool>("ColoredLife");
+
+    try {
+        utils::snapshot::save(file, *m_field, info,
+                              Config::getVal<bool>("DirectIO"));
+        std::cout << "Simulation saved to " << file << std::endl;
+    } catch (const BaseGameException& e) {
+        Logger::write(e.fileLog(), e.categoryError(), e.what());
+    }
+}
+
+void World::load_simulation()
+{
+    // Field entity and systems are created on start
+    if (!m_field)
+        init();
+
+    const auto& file = Config::getVal<std::string>("SnapshotFile");
+    const int regionSize = Config::getVal<int>("SnapshotRegionSize");
+    const uint64_t version = m_field->version;
+    utils::snapshot::SnapshotInfo info{};
+    try {
+        if (regionSize > 0) {
+            auto coord = [](const char* key) {
+                return static_cast<uint64_t>(
+                        std::max(0, Config::getVal<int>(key)));
+            };
+            const auto size = static_cast<uint64_t>(regionSize);
+            info = utils::snapshot::loadRegion(
+                    file, *m_field, {coord("SnapshotRegionX"),
+                                     coord("SnapshotRegionY"),
+                                     coord("SnapshotRegionZ"),
+                                     size, size, size}, &m_pool);
+        } else {
+            info = utils::snapshot::load(file, *m_field, &m_pool);
+        }
+    } catch (const BaseGameException& e) {
+        Logger::write(e.fileLog(), e.categoryError(), e.what());
+        // Field is left dead if broken file was found while decoding
+        if (m_field->version != version)
+            init();
+        return;
+    }
+
+    m_journalReader.reset();
+    restore_field(info);
+    std::cout << "Simulation loaded from " << file << std::endl;
+}
+
+void World::restore_field(const utils::snapshot::SnapshotInfo& info)
+{
+    m_fieldSize = std::max({m_field->sizeX, m_field->sizeY, m_field->sizeZ});
+    Config::getVal<int>("FieldSize") = static_cast<int>(m_fieldSize);
+    Config::getVal<int>("NeirCount") = static_cast<int>(info.neirCount);
+    Config::getVal<int>("NeirCountDie") = static_cast<int>(info.neirCountDie);
+    markChanged<FieldComponent>(field_entity);
+    place_camera();
+    m_journalWriter.reset();
+    m_recordPending = !m_journalReader;
+    m_history.clear();
+    publish_history();
+
+    // Loaded field is continued by start, not recreated.
+    // Headless run never waits for start
+    m_timer.start();
+    m_timer.pause();
+    setGameState(GameStates::PAUSE);
+    if (isHeadless())
+        setGameState(GameStates::PLAY);
+}
+
+void World::publish_field()
+{
+    const auto& name = Config::getVal<std::string>("SharedFieldName");
+    if (name != m_sharedFieldName) {
+        m_sharedFieldName = name;
+        m_sharedField.reset();
+        m_sharedVersion.reset();
+        if (!name.empty())
+            m_sharedField = std::make_unique<
+                    utils::sharedfield::SharedFieldWriter>(name);
+    }
+
+    // Field is copied only when it is changed
+    if (!m_sharedField || !m_field || m_sharedVersion == m_field->version)
+        return;
+
+    try {
+        m_sharedField->publish(*m_field);
+        m_sharedVersion = m_field->version;
+    } catch (const BaseGameException& e) {
+        // Not retried until name is changed
+        Logger::write(e.fileLog(), e.categoryError(), e.what());
+        m_sharedField.reset();
+    }
+}
+
+void World::seek_history(uint64_t generation)
+{
+    if (!m_field || !m_history.seek(generation, *m_field))
+        return;
+
+    markChanged<FieldComponent>(field_entity);
+    markSceneDirty();
+    publish_history();
+
+    // Journal can't go back, it would have generations twice
+    m_recordPending = false;
+    if (m_journalWriter) {
+        m_journalWriter.reset();
+        std::cout << "Journal recording stopped by history seek" << std::endl;
+    }
+
+    // Generation is inspected until start, then simulation
+    // goes on from it and later history is forgotten
+    if (getGameState() == GameStates::PLAY)
+        setGameState(GameStates::PAUSE);
+}
+
+void World::publish_history()
+{
+    setHistoryRange({m_history.getFirstGeneration(),
+                     m_history.getLastGeneration(),
+                     m_field ? m_field->generation : 0});
+}
+
+void World::start_recording()
+{
+    m_journalWriter.reset();
+    if (m_journalReader || !Config::getVal<bool>("RecordJournal"))
+        return;
+
+    utils::snapshot::SnapshotInfo info{
+            static_cast<uint32_t>(Config::getVal<int>("NeirCount")),
+            static_cast<uint32_t>(Config::getVal<int>("NeirCountDie"))};
+    info.hasColors = Config::getVal<bool>("ColoredLife");
+    try {
+        m_journalWriter = std::make_unique<utils::journal::JournalWriter>(
+                Config::getVal<std::string>("JournalFile"), *m_field, info,
+                Config::getVal<int>("JournalKeyframeInterval"));
+    } catch (const BaseGameException& e) {
+        Logger::write(e.fileLog(), e.categoryError(), e.what());
+    }
+}
+
+void World::start_replay()
+{
+    // Recorded journal may be the replayed one, it is closed before
+    // reading and isn't started again until next simulation
+    m_journalWriter.reset();
+    if (!m_field)
+        init();
+    m_recordPending = false;
+
+    const auto& file = Config::getVal<std::string>("JournalFile");
+    try {
+        auto reader = std::make_unique<utils::journal::JournalReader>(file,
+                                                                      &m_pool);
+        reader->seek(reader->getFirstGeneration(), *m_field);
+        m_journalReader = std::move(reader);
+    } catch (const BaseGameException& e) {
+        Logger::write(e.fileLog(), e.categoryError(), e.what());
+        return;
+    }
+
+    restore_field(m_journalReader->getInfo());
+    std::cout << "Replay of " << file << " started" << std::endl;
+}
+
+void World::replay_field()
+{
+    try {
+        if (m_journalReader->next(*m_field)) {
+            markChanged<FieldComponent>(field_entity);
+            return;
         }
+    } catch (const BaseGameException& e) {
+        Logger::write(e.fileLog(), e.categoryError(), e.what());
     }
+
+    std::cout << "Replay finished" << std::endl;
+    if (isHeadless())
+        setGameRunnable(false);
+    else
+        setGameState(GameStates::PAUSE);
+}
+
+void World::resume_checkpoint()
+{
+    const auto& dir = Config::getVal<std::string>("CheckpointDir");
+    auto info = utils::Checkpointer::restore(dir, *m_field, &m_pool);
+    if (!info)
+        return;
+
+    restore_field(*info);
+    std::cout << "Resumed from checkpoint of generation "
+              << m_field->generation << std::endl;
+}
+
+void World::checkpoint_field()
+{
+    if (!m_checkpointer)
+        m_checkpointer = std::make_unique<utils::Checkpointer>(
+                Config::getVal<std::string>("CheckpointDir"),
+                Config::getVal<int>("CheckpointCount"),
+                Config::getVal<bool>("DirectIO"));
+
+    utils::snapshot::SnapshotInfo info{
+            static_cast<uint32_t>(Config::getVal<int>("NeirCount")),
+            static_cast<uint32_t>(Config::getVal<int>("NeirCountDie"))};
+    info.hasColors = Config::getVal<bool>("ColoredLife");
+    if (!m_checkpointer->checkpoint(*m_field, info))
+        std::cout << "Checkpoint skipped, previous one is still written"
+                  << std::endl;
 }
 
 void World::filter_entities()
@@ -304,8 +577,6 @@ void World::filter_entities()
 
 void World::init_field()
 {
-    using utils::math::cantor_pairing;
-
     const std::vector<std::array<size_t, 3>> initial_cells = {
             {0, 0, 0},
             {1, 0, 0},
@@ -343,53 +614,68 @@ void World::init_field()
             {14, 11, 5},
     };
 
-    GLfloat init_x = 0.f;
-    GLfloat init_y = 0.f;
-    GLfloat init_z = 0.f;
-
-    m_cells.resize(boost::extents[0][0][0]); // clear array if reinit
-    m_cells.resize(boost::extents[m_fieldSize][m_fieldSize][m_fieldSize]);
-
-    std::shared_ptr<Sprite> sprite_com = std::make_shared<Sprite>();
-    sprite_com->addTexture(getResourcePath("cube.obj"), cubeSize,
-                               cubeSize, cubeSize);
-    sprite_com->generateDataBuffer();
-    glm::vec4 color = Config::getVal<glm::vec4>("CellColor");
-    for (CellIndex i = 0; i < m_fieldSize; ++i) {
-        for (CellIndex j = 0; j < m_fieldSize; ++j) {
-            for (CellIndex k = 0; k < m_fieldSize; ++k) {
-                utils::Random rand;
-                auto cell = createEntity(cantor_pairing(i, j, k));
-                cell->activate();
-                cell->addComponents<SpriteComponent, CellComponent, PositionComponent>();
-
-                auto pos = cell->getComponent<PositionComponent>();
-                pos->x = init_x + cubeSize * i;
-                pos->y = init_y + cubeSize * j;
-                pos->z = init_z + cubeSize * k;
-
-                auto sprite = cell->getComponent<SpriteComponent>();
-                sprite->sprite = sprite_com;
-
-                auto cellComp = cell->getComponent<CellComponent>();
-                cellComp->color =
-                        {rand.generateu<GLfloat>(0.f, 1.f),
-                         rand.generateu<GLfloat>(0.f, 1.f),
-                         rand.generateu<GLfloat>(0.f, 1.f),
-                         1.f};
-                if (std::count(initial_cells.cbegin(),
-                               initial_cells.cend(),
-                               std::array<size_t, 3>{(size_t)i, (size_t)j, (size_t)k}) != 0) {
-                    cellComp->alive = true;
-                } else {
-                    cellComp->alive = false;
-                }
+    if (!m_field) {
+        auto entity = createEntity(field_entity);
+        entity->activate();
+        entity->addComponents<SpriteComponent, FieldComponent>();
+        m_field = entity->getComponent<FieldComponent>();
+
+        auto sprite = entity->getComponent<SpriteComponent>();
+        sprite->sprite = std::make_shared<Sprite>();
+        sprite->sprite->addTexture(getResourcePath("cube.obj"), cubeSize,
+                                   cubeSize, cubeSize);
+        sprite->sprite->generateDataBuffer();
+    }
 
-                m_cells[i][j][k] = cellComp;
-            }
-        }
+    m_field->cellSize = cubeSize;
+    clear_field();
+
+    if (!place_pattern())
+        for (const auto& [x, y, z]: initial_cells)
+            if (x < m_fieldSize && y < m_fieldSize && z < m_fieldSize)
+                m_field->alive[m_field->index(x, y, z)] = 1;
+
+    markChanged<FieldComponent>(field_entity);
+    place_camera();
+}
+
+void World::clear_field()
+{
+    m_field->resize(m_fieldSize, m_fieldSize, m_fieldSize);
+
+    utils::Random rand;
+    for (auto& color: m_field->colors)
+        color = pack_color({rand.generateu<GLfloat>(0.f, 1.f),
+                            rand.generateu<GLfloat>(0.f, 1.f),
+                            rand.generateu<GLfloat>(0.f, 1.f),
+                            1.f});
+}
+
+bool World::place_pattern()
+{
+    const auto& file = Config::getVal<std::string>("PatternFile");
+    if (file.empty())
+        return false;
+
+    const glm::ivec3 offset = {Config::getVal<int>("PatternOffsetX"),
+                               Config::getVal<int>("PatternOffsetY"),
+                               Config::getVal<int>("PatternOffsetZ")};
+    try {
+        auto result = utils::pattern::place(file, *m_field, offset);
+        std::cout << "Pattern " << file << ": " << result.placed
+                  << " cells placed, " << result.clipped
+                  << " out of field" << std::endl;
+        return true;
+    } catch (const BaseGameException& e) {
+        Logger::write(e.fileLog(), e.categoryError(), e.what());
+        // Cells are placed while file is parsed, part of them is removed
+        clear_field();
+        return false;
     }
+}
 
+void World::place_camera()
+{
     // TODO: fix bug
     auto camera = Camera::getInstance();
     GLfloat pos = m_fieldSize * (cubeSize + 40);
@@ -398,4 +684,5 @@ void World::init_field()
     auto program = LifeProgram::getInstance();
     program->setView(camera->getView());
     program->updateView();
+    markSceneDirty();
 }
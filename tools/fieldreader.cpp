@@ -0,0 +1,109 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "utils/sharedfield.hpp"
+
+/**
+ * Example of external analyzer of published field.
+ * Usage: LifeFieldReader [name] [--count N]
+ * Prints live cells and their bounding box for each new generation,
+ * N generations are printed, 0 runs until interrupted.
+ * Field is read in place from shared memory without copying.
+ */
+
+using utils::sharedfield::FieldView;
+using utils::sharedfield::ReadStatus;
+using utils::sharedfield::SharedFieldReader;
+
+namespace
+{
+    struct Stats
+    {
+        uint64_t generation = 0;
+        uint64_t alive = 0;
+        uint64_t min[3] = {UINT64_MAX, UINT64_MAX, UINT64_MAX};
+        uint64_t max[3] = {0, 0, 0};
+    };
+
+    Stats compute_stats(const FieldView& view)
+    {
+        Stats stats;
+        stats.generation = view.generation;
+        size_t idx = 0;
+        for (uint64_t x = 0; x < view.sizeX; ++x)
+            for (uint64_t y = 0; y < view.sizeY; ++y)
+                for (uint64_t z = 0; z < view.sizeZ; ++z, ++idx) {
+                    if (!view.alive[idx])
+                        continue;
+
+                    ++stats.alive;
+                    const uint64_t pos[3] = {x, y, z};
+                    for (size_t i = 0; i < 3; ++i) {
+                        stats.min[i] = std::min(stats.min[i], pos[i]);
+                        stats.max[i] = std::max(stats.max[i], pos[i]);
+                    }
+                }
+
+        return stats;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name = "/lifegame_field";
+    size_t count = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            count = std::stoull(argv[++i]);
+        } else if (arg[0] == '/') {
+            name = arg;
+        } else {
+            std::cerr << "Usage: LifeFieldReader [name] [--count N]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    SharedFieldReader reader;
+    uint64_t lastGeneration = UINT64_MAX;
+    for (size_t printed = 0; count == 0 || printed < count;) {
+        if (!reader.isOpen() && !reader.open(name)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            continue;
+        }
+
+        Stats stats;
+        switch (reader.read([&stats](const FieldView& view) {
+            stats = compute_stats(view);
+        })) {
+            case ReadStatus::STALE:
+                // Field is resized or game is closed
+                reader.close();
+                continue;
+            case ReadStatus::BUSY:
+                // Writer is copying generation, it is tried again shortly
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            case ReadStatus::OK:
+                break;
+        }
+
+        if (stats.generation != lastGeneration) {
+            lastGeneration = stats.generation;
+            ++printed;
+            std::cout << "generation " << stats.generation << ": "
+                      << stats.alive << " alive";
+            if (stats.alive)
+                std::cout << ", box " << stats.min[0] << ' ' << stats.min[1]
+                          << ' ' << stats.min[2] << " - " << stats.max[0]
+                          << ' ' << stats.max[1] << ' ' << stats.max[2];
+            std::cout << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return 0;
+}